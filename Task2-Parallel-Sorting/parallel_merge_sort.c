@@ -3,176 +3,2563 @@
 #include <omp.h>
 #include <string.h>
 #include <time.h>
+#include <limits.h>
 
-// Minimum size for parallel execution
-// Below this threshold, we use sequential sort for efficiency
-#define PARALLEL_THRESHOLD 5000
-// Maximum task depth to prevent excessive task creation overhead
-#define MAX_TASK_DEPTH 5
+#include "psort.h"
 
-// Function to merge two sorted subarrays (highly optimized)
-void merge(int arr[], int left, int mid, int right) {
-    int n1 = mid - left + 1;
-    int n2 = right - mid;
+// AVX2 kernels are compiled with a target attribute and picked at runtime,
+// so the binary still runs on CPUs without AVX2
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_AVX2_KERNEL 1
+#endif
+
+// Recursion stops at blocks of this many elements, which are sorted
+// directly by the block kernel instead of being split further
+#define BLOCK_SIZE 64
+// Blocks up to this size are insertion sorted (cheaper than the network)
+#define INSERTION_THRESHOLD 16
+// Widest radix digit; 8 bits keeps every thread's write-combining buffers in L1
+#define RADIX_MAX_BITS 8
+// Elements per write-combining buffer (one 64-byte cache line of ints)
+#define RADIX_WC_SIZE 16
+// Presorted stretches at least this long are kept as natural runs; shorter
+// ones are left to the regular merge sort
+#define NATURAL_MIN_RUN 1024
+// Sample sort draws this many sample keys per bucket when picking splitters
+#define SAMPLE_OVERSAMPLE 64
+// Below this many elements per thread, sample sort falls back to one thread
+#define SAMPLE_MIN_BUCKET 16384
+// Quickselect pivots are picked from a sorted sample of this many keys
+#define SELECT_SAMPLE 63
+// Ranges at least this large are partitioned by all threads
+#define SELECT_PARALLEL_MIN 65536
+// top_k uses per-thread heaps while k * threads * this <= n
+#define TOPK_HEAP_RATIO 8
+
+// Merge kernel: merges sorted a[0..na) and b[0..nb) into out[0..na+nb)
+// Ties are taken from a, so the merge is stable
+static inline void merge_runs(const int *a, int na, const int *b, int nb, int *out) {
+    int i = 0, j = 0, k = 0;
+    
+    // Unrolled merge loop for better performance
+    while (i < na && j < nb) {
+        // Process 4 elements at a time when possible
+        if (i + 3 < na && j + 3 < nb) {
+            out[k++] = (a[i] <= b[j]) ? a[i++] : b[j++];
+            out[k++] = (a[i] <= b[j]) ? a[i++] : b[j++];
+            out[k++] = (a[i] <= b[j]) ? a[i++] : b[j++];
+            out[k++] = (a[i] <= b[j]) ? a[i++] : b[j++];
+        } else {
+            out[k++] = (a[i] <= b[j]) ? a[i++] : b[j++];
+        }
+    }
+    
+    // Copy remaining elements using memcpy for efficiency
+    if (i < na) {
+        memcpy(&out[k], &a[i], (na - i) * sizeof(int));
+    }
+    if (j < nb) {
+        memcpy(&out[k], &b[j], (nb - j) * sizeof(int));
+    }
+}
+
+#ifdef HAVE_AVX2_KERNEL
+// Bitonic sort of a bitonic 8-lane vector (compare distances 4, 2, 1)
+__attribute__((target("avx2")))
+static inline __m256i bitonic_clean_8(__m256i v) {
+    __m256i p = _mm256_permute2x128_si256(v, v, 0x01);
+    v = _mm256_blend_epi32(_mm256_min_epi32(v, p), _mm256_max_epi32(v, p), 0xF0);
+    p = _mm256_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2));
+    v = _mm256_blend_epi32(_mm256_min_epi32(v, p), _mm256_max_epi32(v, p), 0xCC);
+    p = _mm256_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1));
+    v = _mm256_blend_epi32(_mm256_min_epi32(v, p), _mm256_max_epi32(v, p), 0xAA);
+    return v;
+}
+
+// Merges two sorted 8-lane vectors: *lo gets the 8 smallest, *hi the 8 largest
+__attribute__((target("avx2")))
+static inline void bitonic_merge_16(__m256i *lo, __m256i *hi) {
+    const __m256i reverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    __m256i b = _mm256_permutevar8x32_epi32(*hi, reverse);
+    __m256i l = _mm256_min_epi32(*lo, b);
+    __m256i h = _mm256_max_epi32(*lo, b);
+    *lo = bitonic_clean_8(l);
+    *hi = bitonic_clean_8(h);
+}
+
+// AVX2 merge kernel: same contract as merge_runs, but merges 8 elements per
+// step with a branch-free bitonic network. The only branch left per step is
+// choosing which input to load the next vector from.
+__attribute__((target("avx2")))
+static void merge_runs_avx2(const int *a, int na, const int *b, int nb, int *out) {
+    if (na < 8 || nb < 8) {
+        merge_runs(a, na, b, nb, out);
+        return;
+    }
+    
+    __m256i lo = _mm256_loadu_si256((const __m256i *)a);
+    __m256i hi = _mm256_loadu_si256((const __m256i *)b);
+    int i = 8, j = 8, k = 0;
+    
+    for (;;) {
+        bitonic_merge_16(&lo, &hi);
+        _mm256_storeu_si256((__m256i *)&out[k], lo);
+        k += 8;
+        
+        // Refill from the input with the smaller head; stop once that input
+        // has less than a full vector left
+        if (i < na && (j >= nb || a[i] <= b[j])) {
+            if (na - i < 8) break;
+            lo = _mm256_loadu_si256((const __m256i *)&a[i]);
+            i += 8;
+        } else {
+            if (nb - j < 8) break;
+            lo = _mm256_loadu_si256((const __m256i *)&b[j]);
+            j += 8;
+        }
+    }
+    
+    // Tail: the 8 elements still in hi, the short input's remainder (< 8)
+    // and the other input's remainder
+    int pending[8], tail[16];
+    _mm256_storeu_si256((__m256i *)pending, hi);
+    
+    if (i < na && (j >= nb || a[i] <= b[j])) {
+        merge_runs(pending, 8, &a[i], na - i, tail);
+        merge_runs(tail, 8 + na - i, &b[j], nb - j, &out[k]);
+    } else {
+        merge_runs(pending, 8, &b[j], nb - j, tail);
+        merge_runs(tail, 8 + nb - j, &a[i], na - i, &out[k]);
+    }
+}
+#endif
+
+// Task cutoff for the parallel merge sort, computed at runtime by
+// parallel_merge_sort() from the team size and n (see psort_compute_cutoff)
+static psort_cutoff_t sort_cutoff = {PSORT_MIN_THRESHOLD, 0, 1, 0};
+
+// When 0 the sort engines skip their progress banners (external sort runs)
+static int sort_verbose = 1;
+
+// Plain insertion sort, used for the smallest blocks and partial groups
+static inline void insertion_sort(int *a, int n) {
+    for (int i = 1; i < n; i++) {
+        int key = a[i];
+        int j = i - 1;
+        while (j >= 0 && a[j] > key) {
+            a[j + 1] = a[j];
+            j--;
+        }
+        a[j + 1] = key;
+    }
+}
+
+// Branch-free compare-exchange (compiles to min/max or cmov)
+static inline void compare_swap(int *a, int i, int j) {
+    int x = a[i], y = a[j];
+    a[i] = (x < y) ? x : y;
+    a[j] = (x < y) ? y : x;
+}
+
+// Optimal 19-comparator sorting network for 8 elements
+static inline void sort8_network(int *a) {
+    compare_swap(a, 0, 2); compare_swap(a, 1, 3); compare_swap(a, 4, 6); compare_swap(a, 5, 7);
+    compare_swap(a, 0, 4); compare_swap(a, 1, 5); compare_swap(a, 2, 6); compare_swap(a, 3, 7);
+    compare_swap(a, 0, 1); compare_swap(a, 2, 3); compare_swap(a, 4, 5); compare_swap(a, 6, 7);
+    compare_swap(a, 2, 4); compare_swap(a, 3, 5);
+    compare_swap(a, 1, 4); compare_swap(a, 3, 6);
+    compare_swap(a, 1, 2); compare_swap(a, 3, 4); compare_swap(a, 5, 6);
+}
+
+// Scalar block kernel: sorts src[0..n) (n <= BLOCK_SIZE) into dst, which may
+// equal src. Groups of 8 go through the network, then bottom-up merges
+// ping-pong between dst and a stack buffer.
+static void sort_block_scalar(const int *src, int *dst, int n) {
+    if (n <= INSERTION_THRESHOLD) {
+        if (dst != src) memcpy(dst, src, n * sizeof(int));
+        insertion_sort(dst, n);
+        return;
+    }
+    
+    int tmp[BLOCK_SIZE];
+    int passes = 0;
+    for (int width = 8; width < n; width *= 2) passes++;
+    
+    // Start in whichever buffer makes the last pass land in dst
+    int *from = (passes % 2) ? tmp : dst;
+    int *to = (passes % 2) ? dst : tmp;
+    memmove(from, src, n * sizeof(int));
+    
+    int g = 0;
+    for (; g + 8 <= n; g += 8) {
+        sort8_network(&from[g]);
+    }
+    insertion_sort(&from[g], n - g);
+    
+    for (int width = 8; width < n; width *= 2) {
+        for (int lo = 0; lo < n; lo += 2 * width) {
+            int mid = (lo + width < n) ? lo + width : n;
+            int hi = (lo + 2 * width < n) ? lo + 2 * width : n;
+            merge_runs(&from[lo], mid - lo, &from[mid], hi - mid, &to[lo]);
+        }
+        int *t = from;
+        from = to;
+        to = t;
+    }
+}
+
+#ifdef HAVE_AVX2_KERNEL
+// Vector compare-exchange: lane-wise min into *x, max into *y
+__attribute__((target("avx2")))
+static inline void compare_swap_vec(__m256i *x, __m256i *y) {
+    __m256i lo = _mm256_min_epi32(*x, *y);
+    *y = _mm256_max_epi32(*x, *y);
+    *x = lo;
+}
+
+// Transpose an 8x8 block of ints held in 8 vectors
+__attribute__((target("avx2")))
+static inline void transpose_8x8(__m256i *v) {
+    __m256i t[8], u[8];
+    for (int i = 0; i < 8; i += 2) {
+        t[i] = _mm256_unpacklo_epi32(v[i], v[i + 1]);
+        t[i + 1] = _mm256_unpackhi_epi32(v[i], v[i + 1]);
+    }
+    for (int i = 0; i < 8; i += 4) {
+        u[i] = _mm256_unpacklo_epi64(t[i], t[i + 2]);
+        u[i + 1] = _mm256_unpackhi_epi64(t[i], t[i + 2]);
+        u[i + 2] = _mm256_unpacklo_epi64(t[i + 1], t[i + 3]);
+        u[i + 3] = _mm256_unpackhi_epi64(t[i + 1], t[i + 3]);
+    }
+    for (int i = 0; i < 4; i++) {
+        v[i] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x20);
+        v[i + 4] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x31);
+    }
+}
+
+// Merge two sorted runs of m vectors each (x low, y high) held in registers
+__attribute__((target("avx2")))
+static inline void bitonic_merge_regs(__m256i *x, __m256i *y, int m) {
+    const __m256i reverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    __m256i r[4];
+    
+    // Reverse y so x ++ reverse(y) is bitonic, then split into low/high halves
+    for (int i = 0; i < m; i++) {
+        r[i] = _mm256_permutevar8x32_epi32(y[m - 1 - i], reverse);
+    }
+    for (int i = 0; i < m; i++) {
+        y[i] = r[i];
+        compare_swap_vec(&x[i], &y[i]);
+    }
+    
+    // Half-cleaners across whole vectors, then within each vector
+    for (int d = m / 2; d >= 1; d /= 2) {
+        for (int i = 0; i < m; i++) {
+            if ((i & d) == 0) {
+                compare_swap_vec(&x[i], &x[i + d]);
+                compare_swap_vec(&y[i], &y[i + d]);
+            }
+        }
+    }
+    for (int i = 0; i < m; i++) {
+        x[i] = bitonic_clean_8(x[i]);
+        y[i] = bitonic_clean_8(y[i]);
+    }
+}
+
+// AVX2 block kernel: same contract as sort_block_scalar. A full 64-element
+// block is sorted entirely in registers: the 8-input network sorts columns,
+// a transpose turns them into sorted rows, and bitonic merges combine rows.
+// Short blocks are padded with INT_MAX.
+__attribute__((target("avx2")))
+static void sort_block_avx2(const int *src, int *dst, int n) {
+    if (n <= INSERTION_THRESHOLD) {
+        if (dst != src) memcpy(dst, src, n * sizeof(int));
+        insertion_sort(dst, n);
+        return;
+    }
+    
+    int padded[BLOCK_SIZE];
+    const int *in = src;
+    if (n < BLOCK_SIZE) {
+        memcpy(padded, src, n * sizeof(int));
+        for (int i = n; i < BLOCK_SIZE; i++) padded[i] = INT_MAX;
+        in = padded;
+    }
+    
+    __m256i v[8];
+    for (int i = 0; i < 8; i++) {
+        v[i] = _mm256_loadu_si256((const __m256i *)&in[8 * i]);
+    }
+    
+    compare_swap_vec(&v[0], &v[2]); compare_swap_vec(&v[1], &v[3]);
+    compare_swap_vec(&v[4], &v[6]); compare_swap_vec(&v[5], &v[7]);
+    compare_swap_vec(&v[0], &v[4]); compare_swap_vec(&v[1], &v[5]);
+    compare_swap_vec(&v[2], &v[6]); compare_swap_vec(&v[3], &v[7]);
+    compare_swap_vec(&v[0], &v[1]); compare_swap_vec(&v[2], &v[3]);
+    compare_swap_vec(&v[4], &v[5]); compare_swap_vec(&v[6], &v[7]);
+    compare_swap_vec(&v[2], &v[4]); compare_swap_vec(&v[3], &v[5]);
+    compare_swap_vec(&v[1], &v[4]); compare_swap_vec(&v[3], &v[6]);
+    compare_swap_vec(&v[1], &v[2]); compare_swap_vec(&v[3], &v[4]); compare_swap_vec(&v[5], &v[6]);
+    
+    transpose_8x8(v);
+    
+    for (int i = 0; i < 8; i += 2) bitonic_merge_regs(&v[i], &v[i + 1], 1);
+    for (int i = 0; i < 8; i += 4) bitonic_merge_regs(&v[i], &v[i + 2], 2);
+    bitonic_merge_regs(&v[0], &v[4], 4);
+    
+    if (n == BLOCK_SIZE) {
+        for (int i = 0; i < 8; i++) {
+            _mm256_storeu_si256((__m256i *)&dst[8 * i], v[i]);
+        }
+    } else {
+        for (int i = 0; i < 8; i++) {
+            _mm256_storeu_si256((__m256i *)&padded[8 * i], v[i]);
+        }
+        memcpy(dst, padded, n * sizeof(int));
+    }
+}
+#endif
+
+// Kernels used by the sort, chosen once by select_sort_kernels()
+typedef void (*merge_kernel_fn)(const int *a, int na, const int *b, int nb, int *out);
+typedef void (*block_kernel_fn)(const int *src, int *dst, int n);
+static merge_kernel_fn merge_kernel = merge_runs;
+static block_kernel_fn sort_block = sort_block_scalar;
+// When many sorted runs are combined by one loser-tree k-way pass rather
+// than by log2(runs) passes of binary merges: at least kway_min_runs runs
+// whose keys plus scratch span at least kway_min_bytes. A scalar binary
+// merge is as branchy as a loser-tree step, so the k-way pass wins from
+// three runs on. A branch-free AVX2 pass costs about a nanosecond per key,
+// well under a loser-tree step, so it only loses once the passes are bound
+// by memory bandwidth: the array spills the last-level cache and enough
+// threads share the bus (PSORT_TASKS_PER_THREAD leaves per thread).
+#define KWAY_AVX2_MIN_RUNS (4 * PSORT_TASKS_PER_THREAD)
+#define DEFAULT_LLC_BYTES (32 * 1024 * 1024)  // Last-level cache assumed when it cannot be queried
+static int kway_min_runs = 3;
+static size_t kway_min_bytes = 0;
+
+// Last-level (L3) cache size in bytes
+static size_t llc_bytes(void) {
+#if defined(__linux__) && defined(_SC_LEVEL3_CACHE_SIZE)
+    long l3 = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    if (l3 > 0) return (size_t)l3;
+#endif
+    return DEFAULT_LLC_BYTES;
+}
+
+// Whether runs sorted runs holding n keys in total get one k-way merge
+static int use_kway_merge(int runs, size_t n) {
+    return runs >= kway_min_runs && 2 * n * sizeof(int) >= kway_min_bytes;
+}
+
+// Pick the fastest merge and block kernels the CPU supports, and when the
+// k-way merge pays off with them. PSORT_KWAY=0 forces binary merges and
+// PSORT_KWAY=1 the k-way merge (from three runs), for measuring either.
+// Returns the kernel set name for reporting
+const char *select_sort_kernels(void) {
+    const char *name = "scalar";
+    unsigned long long forced;
+    
+    merge_kernel = merge_runs;
+    sort_block = sort_block_scalar;
+    kway_min_runs = 3;
+    kway_min_bytes = 0;
+#ifdef HAVE_AVX2_KERNEL
+    if (__builtin_cpu_supports("avx2")) {
+        merge_kernel = merge_runs_avx2;
+        sort_block = sort_block_avx2;
+        kway_min_runs = KWAY_AVX2_MIN_RUNS;
+        kway_min_bytes = llc_bytes();
+        name = "avx2";
+    }
+#endif
+    if (psort_env_number("PSORT_KWAY", &forced)) {
+        kway_min_runs = forced ? 3 : INT_MAX;
+        kway_min_bytes = 0;
+    }
+    return name;
+}
+
+// Co-rank (merge path) search: returns how many of the first k outputs of
+// merging a and b come from a. Ties go to a, matching merge_runs.
+static int co_rank(int k, const int *a, int na, const int *b, int nb) {
+    int lo = (k > nb) ? k - nb : 0;
+    int hi = (k < na) ? k : na;
+    
+    // Find the smallest i with a[i] > b[k - i - 1]
+    while (lo < hi) {
+        int i = lo + (hi - lo) / 2;
+        if (a[i] <= b[k - i - 1]) {
+            lo = i + 1;
+        } else {
+            hi = i;
+        }
+    }
+    return lo;
+}
+
+// Parallel merge of sorted a and b into out. The output is cut into equal
+// slices, co_rank finds where each slice starts in both inputs, and every
+// slice is merged by its own task.
+static void merge_runs_parallel(const int *a, int na, const int *b, int nb, int *out) {
+    int total = na + nb;
+    int parts = omp_get_num_threads();
+    int min_slice = (int)sort_cutoff.threshold;
+    
+    // Keep every slice at least one leaf long
+    if (parts > total / min_slice) {
+        parts = total / min_slice;
+    }
+    if (parts < 2) {
+        merge_kernel(a, na, b, nb, out);
+        return;
+    }
+    
+    for (int p = 0; p < parts; p++) {
+        #pragma omp task firstprivate(p) untied
+        {
+            int k0 = (int)((long long)total * p / parts);
+            int k1 = (int)((long long)total * (p + 1) / parts);
+            int i0 = co_rank(k0, a, na, b, nb);
+            int i1 = co_rank(k1, a, na, b, nb);
+            
+            merge_kernel(a + i0, i1 - i0, b + (k0 - i0), (k1 - i1) - (k0 - i0), out + k0);
+        }
+    }
+    
+    #pragma omp taskwait
+}
+
+// Sequential merge sort with ping-pong buffers
+// Sorts arr[left..right] using aux[left..right] as scratch space. Each level
+// merges from one buffer into the other, so nothing is copied or allocated:
+// the result ends up in arr when to_aux is 0 and in aux when to_aux is 1.
+void merge_sort_sequential_buf(int arr[], int aux[], int left, int right, int to_aux) {
+    int size = right - left + 1;
+    
+    // Leaf: the block kernel sorts straight into the destination buffer
+    if (size <= BLOCK_SIZE) {
+        sort_block(&arr[left], to_aux ? &aux[left] : &arr[left], size);
+        return;
+    }
+    
+    int mid = left + (right - left) / 2;
+    
+    // Sort both halves into the opposite buffer of this level
+    merge_sort_sequential_buf(arr, aux, left, mid, !to_aux);
+    merge_sort_sequential_buf(arr, aux, mid + 1, right, !to_aux);
+    
+    const int *src = to_aux ? arr : aux;
+    int *dst = to_aux ? aux : arr;
+    merge_kernel(&src[left], mid - left + 1, &src[mid + 1], right - mid, &dst[left]);
+}
+
+// Sequential merge sort (for small arrays or when task depth is too high)
+void merge_sort_sequential(int arr[], int left, int right) {
+    if (left >= right) return;
+    
+    int n = right - left + 1;
+    select_sort_kernels();
+    
+    int *aux = (int*)malloc(n * sizeof(int));
+    if (aux == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return;
+    }
+    
+    merge_sort_sequential_buf(&arr[left], aux, 0, n - 1, 0);
+    free(aux);
+}
+
+// Parallel merge sort using OpenMP tasks with depth control (optimized)
+// Same buffer protocol as merge_sort_sequential_buf()
+void merge_sort_parallel_helper(int arr[], int aux[], int left, int right, int depth, int to_aux) {
+    int size = right - left + 1;
+    
+    // Use sequential sort for small arrays or when task depth is too high
+    if (size < (int)sort_cutoff.threshold || depth >= sort_cutoff.max_depth) {
+        merge_sort_sequential_buf(arr, aux, left, right, to_aux);
+        return;
+    }
+    
+    const int *src = to_aux ? arr : aux;
+    int *dst = to_aux ? aux : arr;
+    
+    // More than two leaves: sort them all, then combine them with one k-way
+    // pass instead of log2(leaves) passes of binary merges over the array
+    if (depth == 0 && use_kway_merge(1 << sort_cutoff.max_depth, (size_t)size)) {
+        int kway_depth = sort_cutoff.max_depth;
+        while ((1 << kway_depth) > PSORT_KWAY_MAX_FANIN) kway_depth--;
+        int k = 1 << kway_depth;
+        const int *runs[PSORT_KWAY_MAX_FANIN];
+        int lens[PSORT_KWAY_MAX_FANIN];
+        
+        for (int s = 0; s < k; s++) {
+            int lo = left + (int)((long long)size * s / k);
+            int hi = left + (int)((long long)size * (s + 1) / k);
+            runs[s] = &src[lo];
+            lens[s] = hi - lo;
+            
+            #pragma omp task shared(arr, aux) firstprivate(lo, hi, kway_depth, to_aux) untied
+            merge_sort_parallel_helper(arr, aux, lo, hi - 1, kway_depth, !to_aux);
+        }
+        #pragma omp taskwait
+        
+        psort_kway_merge_parallel(runs, lens, k, &dst[left], &sort_cutoff);
+        return;
+    }
+    
+    int mid = left + (right - left) / 2;
+    
+    // Create untied tasks for better work stealing and load balancing
+    #pragma omp task shared(arr, aux) firstprivate(left, mid, depth, to_aux) untied if(depth < sort_cutoff.max_depth - 1)
+    {
+        merge_sort_parallel_helper(arr, aux, left, mid, depth + 1, !to_aux);
+    }
+    
+    #pragma omp task shared(arr, aux) firstprivate(mid, right, depth, to_aux) untied if(depth < sort_cutoff.max_depth - 1)
+    {
+        merge_sort_parallel_helper(arr, aux, mid + 1, right, depth + 1, !to_aux);
+    }
+    
+    // Wait for both tasks to complete before merging
+    #pragma omp taskwait
+    
+    // Merge the sorted halves, splitting the merge itself across threads
+    merge_runs_parallel(&src[left], mid - left + 1, &src[mid + 1], right - mid, &dst[left]);
+}
+
+// Parallel merge sort using OpenMP tasks
+// aux must have room for right + 1 elements
+void merge_sort_parallel(int arr[], int aux[], int left, int right) {
+    if (left >= right) return;
+    merge_sort_parallel_helper(arr, aux, left, right, 0, 0);
+}
+
+// ----- Natural run detection and adaptive merging -----
+
+// Kinds of stretches found by the run detection pass
+#define RUN_UNSORTED 0
+#define RUN_ASCENDING 1
+#define RUN_DESCENDING 2
+
+typedef struct {
+    int start;
+    int len;
+    int kind;
+} NaturalRun;
+
+// Number of descents (arr[k + 1] < arr[k]) inside arr[w..w+len); written
+// branch-free so the compiler vectorizes it
+static inline int count_descents(const int arr[], int w, int len) {
+    int descents = 0;
+    for (int k = w; k < w + len - 1; k++) {
+        descents += arr[k + 1] < arr[k];
+    }
+    return descents;
+}
+
+// Split arr[begin..end) into runs of at least NATURAL_MIN_RUN elements that
+// are non-decreasing or strictly decreasing (strict so reversing keeps equal
+// keys in order), and the unsorted stretches between them.
+// Any such run contains a whole window of NATURAL_MIN_RUN / 2 elements
+// counted from begin, so the scan only tests windows (vectorized) and
+// extends the ones that are monotone. Random data costs one cheap pass.
+// Returns the number of entries written to runs.
+static int scan_natural_runs(const int arr[], int begin, int end, NaturalRun *runs) {
+    const int window = NATURAL_MIN_RUN / 2;
+    int count = 0;
+    int pending = begin;  // start of the current unsorted stretch
+    int i = begin;
+    
+    while (i + window <= end) {
+        int descents = count_descents(arr, i, window);
+        if (descents != 0 && descents != window - 1) {
+            i += window;
+            continue;
+        }
+        
+        // Monotone window: grow it in both directions
+        int kind = (descents == 0) ? RUN_ASCENDING : RUN_DESCENDING;
+        int s = i, e = i + window;
+        if (kind == RUN_ASCENDING) {
+            while (s > pending && arr[s - 1] <= arr[s]) s--;
+            while (e < end && arr[e] >= arr[e - 1]) e++;
+        } else {
+            while (s > pending && arr[s - 1] > arr[s]) s--;
+            while (e < end && arr[e] < arr[e - 1]) e++;
+        }
+        
+        if (e - s >= NATURAL_MIN_RUN) {
+            if (pending < s) {
+                runs[count++] = (NaturalRun){pending, s - pending, RUN_UNSORTED};
+            }
+            runs[count++] = (NaturalRun){s, e - s, kind};
+            pending = e;
+        }
+        i = e;
+    }
+    
+    if (pending < end) {
+        runs[count++] = (NaturalRun){pending, end - pending, RUN_UNSORTED};
+    }
+    return count;
+}
+
+// Append run r to the list, joining it with the previous entry when the two
+// form one longer run across a chunk boundary
+static void append_natural_run(const int arr[], NaturalRun *runs, int *count, NaturalRun r) {
+    if (*count > 0) {
+        NaturalRun *last = &runs[*count - 1];
+        int edge = last->start + last->len;  // == r.start
+        int joins = 0;
+        
+        if (last->kind == r.kind) {
+            if (r.kind == RUN_ASCENDING) joins = arr[edge - 1] <= arr[edge];
+            else if (r.kind == RUN_DESCENDING) joins = arr[edge - 1] > arr[edge];
+            else joins = 1;  // two unsorted stretches are sorted together
+        }
+        if (joins) {
+            last->len += r.len;
+            return;
+        }
+    }
+    runs[(*count)++] = r;
+}
+
+// dst[i] = src[i] for i < n, split into tasks
+static void copy_parallel(int *dst, const int *src, int n) {
+    int slice = (int)sort_cutoff.threshold;
+    for (int lo = 0; lo < n; lo += slice) {
+        int len = (n - lo < slice) ? n - lo : slice;
+        #pragma omp task firstprivate(lo, len) untied
+        memcpy(&dst[lo], &src[lo], len * sizeof(int));
+    }
+    #pragma omp taskwait
+}
+
+// Reverse src[0..n) into dst, in place when dst == src, split into tasks
+static void reverse_parallel(int *dst, const int *src, int n) {
+    int slice = (int)sort_cutoff.threshold;
+    int half = (dst == src) ? n / 2 : n;
+    
+    for (int lo = 0; lo < half; lo += slice) {
+        int hi = (half - lo < slice) ? half : lo + slice;
+        #pragma omp task firstprivate(lo, hi) untied
+        {
+            if (dst == src) {
+                for (int i = lo; i < hi; i++) {
+                    int t = dst[i];
+                    dst[i] = dst[n - 1 - i];
+                    dst[n - 1 - i] = t;
+                }
+            } else {
+                for (int i = lo; i < hi; i++) {
+                    dst[i] = src[n - 1 - i];
+                }
+            }
+        }
+    }
+    #pragma omp taskwait
+}
+
+// Merge runs[lo..hi) into one sorted range, ping-pong style like
+// merge_sort_parallel_helper(): the result lands in aux when to_aux is set.
+// The run list is split where the element count is halved, so long runs
+// take part in few merges and an already sorted run in none.
+static void merge_natural_runs(int arr[], int aux[], const NaturalRun *runs, int lo, int hi, int to_aux) {
+    int start = runs[lo].start;
+    int end = runs[hi - 1].start + runs[hi - 1].len;
+    
+    if (hi - lo == 1) {
+        if (runs[lo].kind == RUN_UNSORTED) {
+            merge_sort_parallel_helper(arr, aux, start, end - 1, 0, to_aux);
+        } else if (runs[lo].kind == RUN_DESCENDING) {
+            reverse_parallel(to_aux ? &aux[start] : &arr[start], &arr[start], end - start);
+        } else if (to_aux) {
+            copy_parallel(&aux[start], &arr[start], end - start);
+        }
+        return;
+    }
+    
+    const int *src = to_aux ? arr : aux;
+    int *dst = to_aux ? aux : arr;
+    int spawn = (end - start) >= (int)sort_cutoff.threshold;
+    
+    // A handful of runs: bring each into src, then one k-way merge
+    if (hi - lo <= PSORT_KWAY_MAX_FANIN && use_kway_merge(hi - lo, (size_t)(end - start))) {
+        const int *heads[PSORT_KWAY_MAX_FANIN];
+        int lens[PSORT_KWAY_MAX_FANIN];
+        
+        for (int r = lo; r < hi; r++) {
+            heads[r - lo] = &src[runs[r].start];
+            lens[r - lo] = runs[r].len;
+            
+            #pragma omp task shared(arr, aux) firstprivate(r, to_aux) untied if(spawn)
+            merge_natural_runs(arr, aux, runs, r, r + 1, !to_aux);
+        }
+        #pragma omp taskwait
+        
+        psort_kway_merge_parallel(heads, lens, hi - lo, &dst[start], &sort_cutoff);
+        return;
+    }
+    
+    // First run boundary at or past the midpoint (by elements)
+    int target = start + (end - start) / 2;
+    int a = lo + 1, b = hi - 1;
+    while (a < b) {
+        int m = a + (b - a) / 2;
+        if (runs[m].start < target) a = m + 1; else b = m;
+    }
+    int mid = a;
+    if (mid > lo + 1 && target - runs[mid - 1].start < runs[mid].start - target) mid--;
+    
+    #pragma omp task shared(arr, aux) firstprivate(lo, mid, to_aux) untied if(spawn)
+    merge_natural_runs(arr, aux, runs, lo, mid, !to_aux);
+    
+    #pragma omp task shared(arr, aux) firstprivate(mid, hi, to_aux) untied if(spawn)
+    merge_natural_runs(arr, aux, runs, mid, hi, !to_aux);
+    
+    #pragma omp taskwait
+    
+    int split = runs[mid].start;
+    merge_runs_parallel(&src[start], split - start, &src[split], end - split, &dst[start]);
+}
+
+// Adaptive entry point of the parallel merge sort: detect natural runs in
+// parallel chunks, then either return (one ascending run), reverse (one
+// descending run), or merge only the runs and sort only the unsorted parts.
+// Random input collapses to a single unsorted stretch, i.e. a plain merge sort.
+// Must be called from inside a parallel region.
+void merge_sort_adaptive(int arr[], int aux[], int size) {
+    int nchunks = 1 << sort_cutoff.max_depth;
+    if (nchunks > size / NATURAL_MIN_RUN) nchunks = size / NATURAL_MIN_RUN;
+    if (nchunks < 1) nchunks = 1;
+    
+    // Each chunk yields at most two entries per NATURAL_MIN_RUN elements, plus one
+    int per_chunk = 2 * (size / nchunks + 1) / NATURAL_MIN_RUN + 2;
+    NaturalRun *found = (NaturalRun*)malloc((size_t)nchunks * per_chunk * sizeof(NaturalRun));
+    int *found_count = (int*)malloc(nchunks * sizeof(int));
+    if (found == NULL || found_count == NULL) {
+        free(found);
+        free(found_count);
+        merge_sort_parallel(arr, aux, 0, size - 1);
+        return;
+    }
+    
+    for (int c = 0; c < nchunks; c++) {
+        #pragma omp task firstprivate(c) untied
+        {
+            int begin = (int)((long long)size * c / nchunks);
+            int end = (int)((long long)size * (c + 1) / nchunks);
+            found_count[c] = scan_natural_runs(arr, begin, end, &found[(size_t)c * per_chunk]);
+        }
+    }
+    #pragma omp taskwait
+    
+    // Stitch the chunk lists together in place (the list only shrinks)
+    int nruns = 0, natural = 0, presorted = 0;
+    for (int c = 0; c < nchunks; c++) {
+        for (int r = 0; r < found_count[c]; r++) {
+            append_natural_run(arr, found, &nruns, found[(size_t)c * per_chunk + r]);
+        }
+    }
+    for (int r = 0; r < nruns; r++) {
+        if (found[r].kind != RUN_UNSORTED) {
+            natural++;
+            presorted += found[r].len;
+        }
+    }
+    
+    if (sort_verbose) {
+        printf("Natural runs: %d presorted run(s) covering %.1f%% of the input\n",
+               natural, 100.0 * presorted / size);
+    }
+    
+    if (nruns == 1 && found[0].kind == RUN_ASCENDING) {
+        if (sort_verbose) printf("Input is already sorted (O(n) fast path)\n\n");
+    } else if (nruns == 1 && found[0].kind == RUN_DESCENDING) {
+        if (sort_verbose) printf("Input is reverse sorted (O(n) reversal)\n\n");
+        reverse_parallel(arr, arr, size);
+    } else {
+        if (sort_verbose) printf("\n");
+        merge_natural_runs(arr, aux, found, 0, nruns, 0);
+    }
+    
+    free(found);
+    free(found_count);
+}
+
+// Wrapper function to initiate parallel merge sort with optimized task creation
+void parallel_merge_sort(int arr[], int size) {
+    const char *kernel = select_sort_kernels();
+    
+    // One scratch buffer for the whole sort, shared by every merge
+    int *aux = (int*)malloc(size * sizeof(int));
+    if (aux == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        return;
+    }
+    
+    #pragma omp parallel
+    {
+        #pragma omp single nowait
+        {
+            sort_cutoff = psort_compute_cutoff(size, sizeof(int), omp_get_num_threads());
+            
+            if (sort_verbose) {
+                printf("\n----- Starting Parallel Merge Sort -----\n");
+                printf("Using %d threads\n", omp_get_num_threads());
+                printf("Sort kernels: %s\n", kernel);
+                printf("Task cutoff: depth %d (up to %d leaf tasks), leaf threshold %zu elements (%s)\n",
+                       sort_cutoff.max_depth, 1 << sort_cutoff.max_depth, sort_cutoff.threshold,
+                       sort_cutoff.overridden ? "from PSORT_THRESHOLD/PSORT_MAX_DEPTH" : "auto");
+                printf("Final merge: %s\n\n", use_kway_merge(1 << sort_cutoff.max_depth, (size_t)size) ?
+                       "one k-way pass over the leaves" : "binary merge tree");
+            }
+            
+            // Use untied tasks for better work stealing
+            #pragma omp task untied
+            merge_sort_adaptive(arr, aux, size);
+        }
+    }
+    
+    free(aux);
+}
+
+// Parallel LSD radix sort for int keys
+// Keys are biased by the minimum so only the bits spanned by [min, max] are
+// sorted; the digit count and width are picked from that observed range.
+// Each pass: per-thread histograms, one prefix sum over (digit, thread),
+// then a stable scatter through per-thread write-combining buffers.
+void parallel_radix_sort(int arr[], int size) {
+    if (size < 2) return;
+    
+    // Observed key range
+    int min_key = arr[0], max_key = arr[0];
+    #pragma omp parallel for reduction(min:min_key) reduction(max:max_key)
+    for (int i = 0; i < size; i++) {
+        if (arr[i] < min_key) min_key = arr[i];
+        if (arr[i] > max_key) max_key = arr[i];
+    }
+    
+    unsigned int bias = (unsigned int)min_key;
+    unsigned int range = (unsigned int)max_key - bias;
+    int key_bits = 0;
+    while (key_bits < 32 && (range >> key_bits) != 0) key_bits++;
+    
+    int passes = (key_bits + RADIX_MAX_BITS - 1) / RADIX_MAX_BITS;
+    int digit_bits = passes ? (key_bits + passes - 1) / passes : 0;
+    int buckets = 1 << digit_bits;
+    unsigned int mask = (unsigned int)buckets - 1;
+    
+    int max_threads = omp_get_max_threads();
+    int *aux = (int*)malloc(size * sizeof(int));
+    int *counts = (int*)malloc((size_t)max_threads * buckets * sizeof(int));
+    if (aux == NULL || counts == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free(aux);
+        free(counts);
+        return;
+    }
+    
+    #pragma omp parallel
+    {
+        int tid = omp_get_thread_num();
+        int nthreads = omp_get_num_threads();
+        int begin = (int)((long long)size * tid / nthreads);
+        int end = (int)((long long)size * (tid + 1) / nthreads);
+        int *my_counts = &counts[(size_t)tid * buckets];
+        
+        // Write-combining buffers: one cache line per digit, flushed whole
+        int wc[1 << RADIX_MAX_BITS][RADIX_WC_SIZE];
+        int wc_fill[1 << RADIX_MAX_BITS];
+        
+        #pragma omp single
+        if (sort_verbose) {
+            printf("\n----- Starting Parallel Radix Sort -----\n");
+            printf("Using %d threads\n", nthreads);
+            printf("Key range: [%d, %d] -> %d pass(es) of %d bits\n\n",
+                   min_key, max_key, passes, digit_bits);
+        }
+        
+        int *src = arr, *dst = aux;
+        
+        for (int pass = 0; pass < passes; pass++) {
+            int shift = pass * digit_bits;
+            
+            // Per-thread histogram of this digit
+            memset(my_counts, 0, buckets * sizeof(int));
+            for (int i = begin; i < end; i++) {
+                my_counts[(((unsigned int)src[i] - bias) >> shift) & mask]++;
+            }
+            
+            #pragma omp barrier
+            
+            // Exclusive prefix sum in (digit, thread) order keeps the sort stable
+            #pragma omp single
+            {
+                int offset = 0;
+                for (int d = 0; d < buckets; d++) {
+                    for (int t = 0; t < nthreads; t++) {
+                        int c = counts[(size_t)t * buckets + d];
+                        counts[(size_t)t * buckets + d] = offset;
+                        offset += c;
+                    }
+                }
+            }
+            
+            // Scatter through the write-combining buffers
+            memset(wc_fill, 0, buckets * sizeof(int));
+            for (int i = begin; i < end; i++) {
+                int d = (((unsigned int)src[i] - bias) >> shift) & mask;
+                wc[d][wc_fill[d]++] = src[i];
+                if (wc_fill[d] == RADIX_WC_SIZE) {
+                    memcpy(&dst[my_counts[d]], wc[d], RADIX_WC_SIZE * sizeof(int));
+                    my_counts[d] += RADIX_WC_SIZE;
+                    wc_fill[d] = 0;
+                }
+            }
+            for (int d = 0; d < buckets; d++) {
+                if (wc_fill[d] > 0) {
+                    memcpy(&dst[my_counts[d]], wc[d], wc_fill[d] * sizeof(int));
+                }
+            }
+            
+            // Everyone must finish writing before the buffers swap roles
+            #pragma omp barrier
+            
+            int *t = src;
+            src = dst;
+            dst = t;
+        }
+        
+        // An odd number of passes leaves the result in aux
+        if (passes % 2) {
+            memcpy(&arr[begin], &aux[begin], (end - begin) * sizeof(int));
+        }
+    }
+    
+    free(counts);
+    free(aux);
+}
+
+// splitmix64 output function
+static inline uint64_t splitmix64_mix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+// i-th value of the splitmix64 stream started from seed
+static inline uint64_t random_at(uint64_t seed, uint64_t i) {
+    return splitmix64_mix(seed + (i + 1) * 0x9E3779B97F4A7C15ULL);
+}
+
+// Uniform value in [0, bound) from the high 32 bits of a random word
+static inline uint32_t random_below(uint64_t r, uint32_t bound) {
+    return (uint32_t)(((r >> 32) * bound) >> 32);
+}
+
+// Parallel sample sort
+// One bucket per thread. Splitters are picked from an oversampled random
+// sample, then every thread classifies its slice once, recording each
+// element's bucket, and scatters it to its bucket with no second search.
+// Each thread then sorts its own bucket. The bucket memory is first touched
+// by the thread that sorts it, so on NUMA machines every bucket is read
+// from its sorter's node (the sorted result goes back to arr, wherever the
+// caller placed it).
+// If the sample yields equal consecutive splitters (few unique keys, heavy
+// hitters), keys equal to a splitter get an equality bucket of their own
+// between the regular buckets. Those keys are only counted, never moved or
+// sorted, and their output range is filled with the key by all threads, so
+// a heavy key no longer lands in one thread's bucket.
+void parallel_sample_sort(int arr[], int size) {
+    int max_threads = omp_get_max_threads();
+    select_sort_kernels();
+    
+    if (max_threads < 2 || size < max_threads * SAMPLE_MIN_BUCKET) {
+        merge_sort_sequential(arr, 0, size - 1);
+        return;
+    }
+    
+    int sample_size = max_threads * SAMPLE_OVERSAMPLE;
+    int *buckets = (int*)malloc((size_t)size * sizeof(int));
+    uint16_t *oracle = (uint16_t*)malloc((size_t)size * sizeof(uint16_t));
+    // Room for the equality buckets: up to 2 * threads - 1 buckets
+    int *counts = (int*)malloc((size_t)max_threads * (2 * max_threads - 1) * sizeof(int));
+    int *bucket_start = (int*)malloc(2 * max_threads * sizeof(int));
+    int *sample = (int*)malloc(sample_size * sizeof(int));
+    // Splitters padded to a power of two for the branchless search
+    int *splitters = (int*)malloc(2 * max_threads * sizeof(int));
+    if (buckets == NULL || oracle == NULL || counts == NULL || bucket_start == NULL ||
+        sample == NULL || splitters == NULL) {
+        fprintf(stderr, "Error: Memory allocation failed\n");
+        free(buckets);
+        free(oracle);
+        free(counts);
+        free(bucket_start);
+        free(sample);
+        free(splitters);
+        return;
+    }
+    
+    int search_span = 1;
+    int equal_buckets = 0;   // Regular bucket j is bucket 2j, keys == splitters[j] go to 2j + 1
+    int nbuckets = 0;
+    
+    #pragma omp parallel
+    {
+        int tid = omp_get_thread_num();
+        int nthreads = omp_get_num_threads();
+        int begin = (int)((long long)size * tid / nthreads);
+        int end = (int)((long long)size * (tid + 1) / nthreads);
+        
+        // Splitters: every SAMPLE_OVERSAMPLE-th key of a sorted random sample
+        #pragma omp single
+        {
+            int n = nthreads * SAMPLE_OVERSAMPLE;
+            for (int i = 0; i < n; i++) {
+                sample[i] = arr[random_below(random_at((uint64_t)size, i), (uint32_t)size)];
+            }
+            merge_sort_sequential(sample, 0, n - 1);
+            
+            while (search_span < nthreads) search_span *= 2;
+            for (int b = 0; b < search_span - 1; b++) {
+                splitters[b] = (b < nthreads - 1) ? sample[(b + 1) * SAMPLE_OVERSAMPLE] : INT_MAX;
+            }
+            for (int b = 0; b + 1 < nthreads - 1; b++) {
+                if (splitters[b] == splitters[b + 1]) equal_buckets = 1;
+            }
+            nbuckets = equal_buckets ? 2 * nthreads - 1 : nthreads;
+        }
+        
+        // Classification: bucket = number of splitters <= key, or the
+        // equality bucket of the largest such splitter if key equals it
+        int *my_counts = &counts[(size_t)tid * nbuckets];
+        memset(my_counts, 0, nbuckets * sizeof(int));
+        for (int i = begin; i < end; i++) {
+            int key = arr[i];
+            int b = 0;
+            for (int step = search_span / 2; step > 0; step /= 2) {
+                b += (splitters[b + step - 1] <= key) ? step : 0;
+            }
+            if (b > nthreads - 1) b = nthreads - 1;
+            if (equal_buckets) b = (b > 0 && key == splitters[b - 1]) ? 2 * b - 1 : 2 * b;
+            oracle[i] = (uint16_t)b;
+            my_counts[b]++;
+        }
+        
+        #pragma omp barrier
+        
+        // Exclusive prefix sum in (bucket, thread) order
+        #pragma omp single
+        {
+            int offset = 0;
+            for (int b = 0; b < nbuckets; b++) {
+                bucket_start[b] = offset;
+                for (int t = 0; t < nthreads; t++) {
+                    int c = counts[(size_t)t * nbuckets + b];
+                    counts[(size_t)t * nbuckets + b] = offset;
+                    offset += c;
+                }
+            }
+            bucket_start[nbuckets] = offset;
+            
+            if (sort_verbose) {
+                int largest = 0, equal = 0;
+                for (int b = 0; b < nbuckets; b++) {
+                    int n = bucket_start[b + 1] - bucket_start[b];
+                    if (equal_buckets && (b & 1)) {
+                        equal += n;
+                    } else if (n > largest) {
+                        largest = n;
+                    }
+                }
+                printf("\n----- Starting Parallel Sample Sort -----\n");
+                printf("Using %d threads, %d buckets from %d sampled keys\n",
+                       nthreads, nbuckets, nthreads * SAMPLE_OVERSAMPLE);
+                if (equal_buckets) {
+                    printf("Equal splitters: %d keys (%.1f%%) in %d equality buckets, not sorted\n",
+                           equal, 100.0 * equal / size, nbuckets - nthreads);
+                }
+                printf("Largest bucket: %d elements (%.2fx the average)\n\n",
+                       largest, (double)largest * nthreads / size);
+            }
+        }
+        
+        // First touch: place this thread's bucket pages on its own node
+        int my_bucket = equal_buckets ? 2 * tid : tid;
+        int my_begin = bucket_start[my_bucket];
+        int my_size = bucket_start[my_bucket + 1] - my_begin;
+        memset(&buckets[my_begin], 0, (size_t)my_size * sizeof(int));
+        
+        #pragma omp barrier
+        
+        // Scatter using the recorded bucket of every element; keys of an
+        // equality bucket stay where they are
+        for (int i = begin; i < end; i++) {
+            int b = oracle[i];
+            if (equal_buckets && (b & 1)) continue;
+            buckets[my_counts[b]++] = arr[i];
+        }
+        
+        #pragma omp barrier
+        
+        // Equality buckets: fill their output ranges, split over all threads
+        for (int b = 1; equal_buckets && b < nbuckets; b += 2) {
+            int key = splitters[b / 2];
+            #pragma omp for schedule(static) nowait
+            for (int i = bucket_start[b]; i < bucket_start[b + 1]; i++) {
+                arr[i] = key;
+            }
+        }
+        
+        // Local sort of this thread's bucket; the matching range of arr is
+        // free now and serves as the scratch buffer that receives the result
+        if (my_size > 0) {
+            merge_sort_sequential_buf(&buckets[my_begin], &arr[my_begin], 0, my_size - 1, 1);
+        }
+    }
+    
+    free(buckets);
+    free(oracle);
+    free(counts);
+    free(bucket_start);
+    free(sample);
+    free(splitters);
+}
+
+// ----- Selection: nth_element, partial_sort and top_k -----
+
+// Pivot for finding rank target in a[0..n): sort SELECT_SAMPLE random keys
+// and take the one whose rank in the sample matches target's, nudged a few
+// places outwards so target most likely lands on the smaller side of the
+// partition. Each round then keeps only a few percent of the range.
+static int select_pivot(const int *a, int n, int target, uint64_t round) {
+    int sample[SELECT_SAMPLE];
+    for (int i = 0; i < SELECT_SAMPLE; i++) {
+        sample[i] = a[random_below(random_at(round, i), (uint32_t)n)];
+    }
+    insertion_sort(sample, SELECT_SAMPLE);
+    
+    int idx = (int)((long long)target * SELECT_SAMPLE / n);
+    idx += (idx < SELECT_SAMPLE / 2) ? 3 : -3;
+    if (idx < 0) idx = 0;
+    if (idx > SELECT_SAMPLE - 1) idx = SELECT_SAMPLE - 1;
+    return sample[idx];
+}
+
+// Sequential quickselect with three-way partitioning, so runs of equal keys
+// end the search instead of slowing it down. Large ranges use a sampled
+// pivot, small ones a single random key.
+static void nth_element_sequential(int *a, int n, int nth) {
+    int lo = 0, hi = n;
+    uint64_t round = (uint64_t)n;
+    
+    while (hi - lo > INSERTION_THRESHOLD) {
+        int pivot = (hi - lo >= 16 * SELECT_SAMPLE)
+                  ? select_pivot(&a[lo], hi - lo, nth - lo, round++)
+                  : a[lo + random_below(random_at((uint64_t)n, round++), (uint32_t)(hi - lo))];
+        int lt = lo, i = lo, gt = hi;
+        
+        while (i < gt) {
+            int x = a[i];
+            if (x < pivot) {
+                a[i++] = a[lt];
+                a[lt++] = x;
+            } else if (x > pivot) {
+                a[i] = a[--gt];
+                a[gt] = x;
+            } else {
+                i++;
+            }
+        }
+        
+        if (nth < lt) {
+            hi = lt;
+        } else if (nth >= gt) {
+            lo = gt;
+        } else {
+            return;
+        }
+    }
+    insertion_sort(a + lo, hi - lo);
+}
+
+// Parallel three-way partition of a[0..n) around pivot, through aux: each
+// thread counts its slice, a prefix sum in thread order places the
+// (less, equal, greater) groups, every thread scatters its slice, then
+// copies its slice of the result back. counts needs 3 ints per thread.
+static void partition_parallel(int *a, int *aux, int n, int pivot, int *counts,
+                               int *n_less, int *n_equal) {
+    #pragma omp parallel
+    {
+        int tid = omp_get_thread_num();
+        int nthreads = omp_get_num_threads();
+        int begin = (int)((long long)n * tid / nthreads);
+        int end = (int)((long long)n * (tid + 1) / nthreads);
+        int less = 0, equal = 0;
+        
+        for (int i = begin; i < end; i++) {
+            less += (a[i] < pivot);
+            equal += (a[i] == pivot);
+        }
+        counts[3 * tid] = less;
+        counts[3 * tid + 1] = equal;
+        counts[3 * tid + 2] = (end - begin) - less - equal;
+        
+        #pragma omp barrier
+        
+        #pragma omp single
+        {
+            int total_less = 0, total_equal = 0;
+            for (int t = 0; t < nthreads; t++) {
+                total_less += counts[3 * t];
+                total_equal += counts[3 * t + 1];
+            }
+            int off[3] = {0, total_less, total_less + total_equal};
+            for (int t = 0; t < nthreads; t++) {
+                for (int g = 0; g < 3; g++) {
+                    int c = counts[3 * t + g];
+                    counts[3 * t + g] = off[g];
+                    off[g] += c;
+                }
+            }
+            *n_less = total_less;
+            *n_equal = total_equal;
+        }
+        
+        int pos_less = counts[3 * tid];
+        int pos_equal = counts[3 * tid + 1];
+        int pos_greater = counts[3 * tid + 2];
+        for (int i = begin; i < end; i++) {
+            int x = a[i];
+            if (x < pivot) {
+                aux[pos_less++] = x;
+            } else if (x == pivot) {
+                aux[pos_equal++] = x;
+            } else {
+                aux[pos_greater++] = x;
+            }
+        }
+        
+        #pragma omp barrier
+        
+        memcpy(&a[begin], &aux[begin], (end - begin) * sizeof(int));
+    }
+}
+
+// Rearranges arr so arr[nth] holds the value it would have after sorting,
+// with nothing greater before it and nothing smaller after it. Parallel
+// quickselect: large ranges are split by parallel three-way partitions
+// around a sampled pivot, and only the side holding nth is kept; once the
+// range is small it is finished by the sequential quickselect.
+void parallel_nth_element(int arr[], int size, int nth) {
+    if (size < 2 || nth < 0 || nth >= size) return;
+    
+    int max_threads = omp_get_max_threads();
+    int *aux = NULL, *counts = NULL;
+    if (max_threads > 1 && size >= SELECT_PARALLEL_MIN) {
+        aux = (int*)malloc((size_t)size * sizeof(int));
+        counts = (int*)malloc(3 * max_threads * sizeof(int));
+    }
+    
+    int lo = 0, hi = size;
+    uint64_t round = 0;
+    while (aux != NULL && counts != NULL && hi - lo >= SELECT_PARALLEL_MIN) {
+        int n_less, n_equal;
+        int pivot = select_pivot(&arr[lo], hi - lo, nth - lo, round++);
+        partition_parallel(&arr[lo], &aux[lo], hi - lo, pivot, counts, &n_less, &n_equal);
+        
+        if (nth < lo + n_less) {
+            hi = lo + n_less;
+        } else if (nth >= lo + n_less + n_equal) {
+            lo += n_less + n_equal;
+        } else {
+            lo = hi = nth;   // nth lands among the copies of the pivot
+        }
+    }
+    free(aux);
+    free(counts);
+    
+    if (hi - lo > 1) {
+        nth_element_sequential(&arr[lo], hi - lo, nth - lo);
+    }
+}
+
+// Sorts the k smallest elements of arr into arr[0..k); the order of the
+// rest is unspecified. Selection first, then a parallel sort of the prefix.
+void parallel_partial_sort(int arr[], int size, int k) {
+    if (k <= 0 || size < 2) return;
+    if (k > size) k = size;
+    
+    if (k < size) {
+        parallel_nth_element(arr, size, k - 1);
+    }
+    
+    int verbose = sort_verbose;
+    sort_verbose = 0;
+    parallel_merge_sort(arr, k);
+    sort_verbose = verbose;
+}
+
+// Restores the max-heap property below position i of heap[0..n)
+static inline void heap_sift_down(int *heap, int n, int i) {
+    int x = heap[i];
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= n) break;
+        if (child + 1 < n && heap[child + 1] > heap[child]) child++;
+        if (heap[child] <= x) break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = x;
+}
+
+// Writes the k smallest elements of arr to out in ascending order, leaving
+// arr untouched. For small k every thread keeps a max-heap of the k
+// smallest keys of its slice, so each element costs one compare against
+// the heap top; the threads' candidates are then sorted and cut to k.
+// Larger k copies the input and runs parallel_partial_sort on the copy.
+// Returns 0, or -1 if memory runs out.
+int parallel_top_k(const int arr[], int size, int k, int out[]) {
+    if (k <= 0 || size <= 0) return 0;
+    if (k > size) k = size;
+    
+    int max_threads = omp_get_max_threads();
+    int heap_path = (long long)k * max_threads * TOPK_HEAP_RATIO <= size;
+    int *work = (int*)malloc((size_t)(heap_path ? (long long)k * max_threads : size) * sizeof(int));
+    int *fill = (int*)calloc(max_threads, sizeof(int));
+    if (work == NULL || fill == NULL) {
+        free(work);
+        free(fill);
+        return -1;
+    }
+    
+    if (!heap_path) {
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < size; i++) {
+            work[i] = arr[i];
+        }
+        parallel_partial_sort(work, size, k);
+        memcpy(out, work, (size_t)k * sizeof(int));
+        free(work);
+        free(fill);
+        return 0;
+    }
+    
+    #pragma omp parallel
+    {
+        int tid = omp_get_thread_num();
+        int nthreads = omp_get_num_threads();
+        int begin = (int)((long long)size * tid / nthreads);
+        int end = (int)((long long)size * (tid + 1) / nthreads);
+        int *heap = &work[(size_t)tid * k];
+        int n = (end - begin < k) ? end - begin : k;
+        
+        memcpy(heap, &arr[begin], n * sizeof(int));
+        for (int i = n / 2 - 1; i >= 0; i--) {
+            heap_sift_down(heap, n, i);
+        }
+        for (int i = begin + n; i < end; i++) {
+            if (arr[i] < heap[0]) {
+                heap[0] = arr[i];
+                heap_sift_down(heap, n, 0);
+            }
+        }
+        fill[tid] = n;
+    }
+    
+    // Pack the candidates together, sort them and keep the first k
+    int total = 0;
+    for (int t = 0; t < max_threads; t++) {
+        memmove(&work[total], &work[(size_t)t * k], fill[t] * sizeof(int));
+        total += fill[t];
+    }
+    merge_sort_sequential(work, 0, total - 1);
+    memcpy(out, work, (size_t)k * sizeof(int));
+    
+    free(work);
+    free(fill);
+    return 0;
+}
+
+// Sort engines selectable with --engine
+typedef struct {
+    const char *name;
+    void (*sort)(int arr[], int size);
+    size_t scratch_bytes;  // Scratch the engine allocates per element sorted
+} SortEngine;
+
+// Single-threaded baseline for speedup figures
+static void sequential_merge_sort(int arr[], int size) {
+    merge_sort_sequential(arr, 0, size - 1);
+}
+
+static const SortEngine sort_engines[] = {
+    {"merge", parallel_merge_sort, sizeof(int)},
+    {"radix", parallel_radix_sort, sizeof(int)},
+    {"sample", parallel_sample_sort, sizeof(int) + sizeof(uint16_t)},  // Buckets plus bucket oracle
+    {"sequential", sequential_merge_sort, sizeof(int)},
+};
+
+static const SortEngine *find_sort_engine(const char *name) {
+    for (size_t i = 0; i < sizeof(sort_engines) / sizeof(sort_engines[0]); i++) {
+        if (strcmp(sort_engines[i].name, name) == 0) {
+            return &sort_engines[i];
+        }
+    }
+    return NULL;
+}
+
+// Function to print array
+void print_array(int arr[], int size, int max_elements) {
+    int print_count = (size < max_elements) ? size : max_elements;
+    
+    for (int i = 0; i < print_count; i++) {
+        printf("%d ", arr[i]);
+    }
+    
+    if (size > max_elements) {
+        printf("... (%d more elements)", size - max_elements);
+    }
+    printf("\n");
+}
+
+// ----- Input generation and verification -----
+
+// Inputs come from a counter-based generator: element i is the i-th output
+// of a splitmix64 stream, computed directly from (seed, i). Every thread
+// fills its own slice with no shared state, and a seed reproduces the same
+// array whatever the thread count.
+
+// Function to verify if array is sorted (parallel scan)
+int is_sorted(int arr[], int size) {
+    int sorted = 1;
+    
+    #pragma omp parallel for reduction(&&:sorted)
+    for (int i = 0; i < size - 1; i++) {
+        sorted = sorted && (arr[i] <= arr[i + 1]);
+    }
+    return sorted;
+}
+
+// Order-independent checksum of the multiset of values in arr: a sort must
+// leave it unchanged, so comparing it before and after catches lost,
+// duplicated or corrupted elements that a sortedness check alone misses
+uint64_t array_checksum(const int arr[], int size) {
+    uint64_t sum = 0;
+    
+    #pragma omp parallel for reduction(+:sum)
+    for (int i = 0; i < size; i++) {
+        sum += splitmix64_mix((uint32_t)arr[i]);
+    }
+    return sum;
+}
+
+// Function to generate random array: uniform in [0, 10000), in parallel
+void generate_random_array(int arr[], int size, uint64_t seed) {
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < size; i++) {
+        arr[i] = (int)random_below(random_at(seed, i), 10000);
+    }
+}
+
+// Fill arr with a non-decreasing sequence with random gaps
+static void generate_sorted_run(int arr[], int size) {
+    int value = rand() % 4;
+    for (int i = 0; i < size; i++) {
+        value += rand() % 4;
+        arr[i] = value;
+    }
+}
+
+// Time one merge of a and b into out; best of several repetitions
+static double time_merge_kernel(merge_kernel_fn kernel, const int *a, int na,
+                                const int *b, int nb, int *out, int reps) {
+    double best = 0.0;
+    for (int r = 0; r < reps; r++) {
+        double start = omp_get_wtime();
+        kernel(a, na, b, nb, out);
+        double elapsed = omp_get_wtime() - start;
+        if (r == 0 || elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+// Benchmark the scalar merge against the AVX2 bitonic kernel
+// Merges two random sorted halves of each size on a single thread
+int bench_merge_kernels(void) {
+    const int sizes[] = {1000000, 10000000, 50000000};
+    const int num_sizes = sizeof(sizes) / sizeof(sizes[0]);
+    const int reps = 5;
+    int status = 0;
+    
+    printf("\n----- Merge Kernel Benchmark -----\n");
+#ifdef HAVE_AVX2_KERNEL
+    int have_avx2 = __builtin_cpu_supports("avx2");
+#else
+    int have_avx2 = 0;
+#endif
+    printf("AVX2 available: %s\n\n", have_avx2 ? "yes" : "no");
+    printf("%12s %12s %12s %10s %14s\n", "Elements", "Scalar (s)", "AVX2 (s)", "Speedup", "AVX2 Melem/s");
+    
+    srand(time(NULL));
+    
+    for (int s = 0; s < num_sizes; s++) {
+        int n = sizes[s];
+        int na = n / 2, nb = n - n / 2;
+        int *input = (int*)malloc(n * sizeof(int));
+        int *out_scalar = (int*)malloc(n * sizeof(int));
+        int *out_avx2 = (int*)malloc(n * sizeof(int));
+        
+        if (input == NULL || out_scalar == NULL || out_avx2 == NULL) {
+            printf("Error: Memory allocation failed for %d elements\n", n);
+            free(input);
+            free(out_scalar);
+            free(out_avx2);
+            return 1;
+        }
+        
+        generate_sorted_run(input, na);
+        generate_sorted_run(input + na, nb);
+        
+        double scalar_time = time_merge_kernel(merge_runs, input, na, input + na, nb, out_scalar, reps);
+        
+        if (have_avx2) {
+#ifdef HAVE_AVX2_KERNEL
+            double avx2_time = time_merge_kernel(merge_runs_avx2, input, na, input + na, nb, out_avx2, reps);
+            int match = memcmp(out_scalar, out_avx2, n * sizeof(int)) == 0;
+            
+            printf("%12d %12.6f %12.6f %9.2fx %14.1f%s\n", n, scalar_time, avx2_time,
+                   scalar_time / avx2_time, n / avx2_time / 1e6,
+                   match ? "" : "  (MISMATCH)");
+            if (!match) status = 1;
+#endif
+        } else {
+            printf("%12d %12.6f %12s %10s %14s\n", n, scalar_time, "-", "-", "-");
+        }
+        
+        free(input);
+        free(out_scalar);
+        free(out_avx2);
+    }
+    
+    return status;
+}
+
+// ----- Typed psort API demo (--type) -----
+
+// qsort-style comparisons for the generic psort() path
+static int cmp_i32(const void *a, const void *b) {
+    int32_t x = *(const int32_t *)a, y = *(const int32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static int cmp_f32(const void *a, const void *b) {
+    float x = *(const float *)a, y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+static int cmp_f64(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static int cmp_kv(const void *a, const void *b) {
+    uint64_t x = ((const psort_kv_t *)a)->key, y = ((const psort_kv_t *)b)->key;
+    return (x > y) - (x < y);
+}
+
+// Random 32-bit value from two rand() calls (RAND_MAX may be only 32767)
+static uint32_t rand_u32(void) {
+    return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+static void fill_i32(void *base, int size) {
+    for (int i = 0; i < size; i++) ((int32_t *)base)[i] = (int32_t)rand_u32();
+}
+
+static void fill_u32(void *base, int size) {
+    for (int i = 0; i < size; i++) ((uint32_t *)base)[i] = rand_u32();
+}
+
+static void fill_u64(void *base, int size) {
+    for (int i = 0; i < size; i++) ((uint64_t *)base)[i] = ((uint64_t)rand_u32() << 32) | rand_u32();
+}
+
+static void fill_f32(void *base, int size) {
+    for (int i = 0; i < size; i++) ((float *)base)[i] = (float)rand() / RAND_MAX * 2000.0f - 1000.0f;
+}
+
+static void fill_f64(void *base, int size) {
+    for (int i = 0; i < size; i++) ((double *)base)[i] = (double)rand_u32() / 4294967296.0 - 0.5;
+}
+
+// Few distinct keys, so stability (index order within a key) is visible
+static void fill_kv(void *base, int size) {
+    psort_kv_t *kv = (psort_kv_t *)base;
+    for (int i = 0; i < size; i++) {
+        kv[i].key = rand() % 10000;
+        kv[i].index = i;
+    }
+}
+
+static int sort_i32(void *base, size_t n) { return psort_i32((int32_t *)base, n); }
+static int sort_u32(void *base, size_t n) { return psort_u32((uint32_t *)base, n); }
+static int sort_u64(void *base, size_t n) { return psort_u64((uint64_t *)base, n); }
+static int sort_f32(void *base, size_t n) { return psort_f32((float *)base, n); }
+static int sort_f64(void *base, size_t n) { return psort_f64((double *)base, n); }
+static int sort_kv(void *base, size_t n) { return psort_kv((psort_kv_t *)base, n); }
+
+typedef struct {
+    const char *name;
+    size_t elem_size;
+    void (*fill)(void *base, int size);
+    int (*sort)(void *base, size_t n);
+    psort_cmp_fn cmp;
+} TypedSort;
+
+static const TypedSort typed_sorts[] = {
+    {"i32", sizeof(int32_t), fill_i32, sort_i32, cmp_i32},
+    {"u32", sizeof(uint32_t), fill_u32, sort_u32, cmp_u32},
+    {"u64", sizeof(uint64_t), fill_u64, sort_u64, cmp_u64},
+    {"f32", sizeof(float), fill_f32, sort_f32, cmp_f32},
+    {"f64", sizeof(double), fill_f64, sort_f64, cmp_f64},
+    {"kv", sizeof(psort_kv_t), fill_kv, sort_kv, cmp_kv},
+};
+
+// Sort the same random data with the specialised psort variant and with
+// generic psort(), verify both, and compare their times
+int run_typed_sort(const char *type, int size) {
+    const TypedSort *ts = NULL;
+    for (size_t i = 0; i < sizeof(typed_sorts) / sizeof(typed_sorts[0]); i++) {
+        if (strcmp(typed_sorts[i].name, type) == 0) ts = &typed_sorts[i];
+    }
+    if (ts == NULL) {
+        printf("Error: Unknown type '%s' (use i32, u32, u64, f32, f64 or kv)\n", type);
+        return 1;
+    }
+    
+    char *data = (char*)malloc((size_t)size * ts->elem_size);
+    char *copy = (char*)malloc((size_t)size * ts->elem_size);
+    if (data == NULL || copy == NULL) {
+        printf("Error: Memory allocation failed\n");
+        free(data);
+        free(copy);
+        return 1;
+    }
     
-    // Use stack allocation for small arrays to avoid malloc overhead
-    int *L, *R;
-    int stack_L[1024], stack_R[1024];
+    srand(time(NULL));
+    ts->fill(data, size);
+    memcpy(copy, data, (size_t)size * ts->elem_size);
     
-    if (n1 <= 1024 && n2 <= 1024) {
-        L = stack_L;
-        R = stack_R;
-    } else {
-        L = (int*)malloc(n1 * sizeof(int));
-        R = (int*)malloc(n2 * sizeof(int));
+    printf("\n----- psort API: %d x %s (%zu-byte elements) -----\n", size, ts->name, ts->elem_size);
+    printf("Using %d threads\n\n", omp_get_max_threads());
+    
+    double start_time = omp_get_wtime();
+    int rc_typed = ts->sort(data, size);
+    double typed_time = omp_get_wtime() - start_time;
+    
+    start_time = omp_get_wtime();
+    int rc_generic = psort(copy, size, ts->elem_size, ts->cmp);
+    double generic_time = omp_get_wtime() - start_time;
+    
+    // Both sorts are stable, so their outputs must be byte-identical
+    int ok = (rc_typed == 0 && rc_generic == 0);
+    for (int i = 1; ok && i < size; i++) {
+        const char *prev = data + (size_t)(i - 1) * ts->elem_size;
+        const char *cur = data + (size_t)i * ts->elem_size;
+        int c = ts->cmp(prev, cur);
+        if (c > 0 || (c == 0 && ts->cmp == cmp_kv &&
+                      ((const psort_kv_t *)prev)->index > ((const psort_kv_t *)cur)->index)) {
+            ok = 0;
+        }
+    }
+    if (ok && memcmp(data, copy, (size_t)size * ts->elem_size) != 0) ok = 0;
+    
+    printf("Specialised psort_%s: %.6f seconds\n", ts->name, typed_time);
+    printf("Generic psort():    %.6f seconds\n", generic_time);
+    if (typed_time > 0) {
+        printf("Inlined comparison speedup: %.2fx\n", generic_time / typed_time);
+    }
+    printf(ok ? "\n✓ Both outputs sorted, stable and identical!\n"
+              : "\n✗ Error: Typed sort results are wrong!\n");
+    
+    free(data);
+    free(copy);
+    return ok ? 0 : 1;
+}
+
+// ----- Argsort demo (--argsort) -----
+
+// Sort a table of three columns by one of them: argsort the key column,
+// then gather every column through the permutation
+int run_argsort_demo(int size, uint64_t seed) {
+    int32_t *keys = (int32_t*)malloc((size_t)size * sizeof(int32_t));
+    double *values = (double*)malloc((size_t)size * sizeof(double));
+    int32_t *ids = (int32_t*)malloc((size_t)size * sizeof(int32_t));
+    uint32_t *perm = (uint32_t*)malloc((size_t)size * sizeof(uint32_t));
+    int32_t *keys_out = (int32_t*)malloc((size_t)size * sizeof(int32_t));
+    double *values_out = (double*)malloc((size_t)size * sizeof(double));
+    int32_t *ids_out = (int32_t*)malloc((size_t)size * sizeof(int32_t));
+    int ok = 0;
+    
+    if (keys == NULL || values == NULL || ids == NULL || perm == NULL ||
+        keys_out == NULL || values_out == NULL || ids_out == NULL) {
+        printf("Error: Memory allocation failed\n");
+        goto done;
+    }
+    
+    // Few distinct keys, so stability (index order within a key) is visible
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < size; i++) {
+        keys[i] = (int32_t)random_below(random_at(seed, i), 10000);
+        values[i] = (double)random_at(seed + 1, i) / 18446744073709551616.0;
+        ids[i] = i;
     }
     
-    // Copy data to temporary arrays (optimized with memcpy)
-    memcpy(L, &arr[left], n1 * sizeof(int));
-    memcpy(R, &arr[mid + 1], n2 * sizeof(int));
+    printf("\n----- Argsort: %d rows x 3 columns -----\n", size);
+    printf("Using %d threads\n\n", omp_get_max_threads());
     
-    // Merge the temporary arrays back into arr[left..right]
-    int i = 0, j = 0, k = left;
+    double start_time = omp_get_wtime();
+    int rc = psort_argsort_i32(keys, size, perm);
+    double argsort_time = omp_get_wtime() - start_time;
+    if (rc != 0) {
+        printf("Error: Argsort failed\n");
+        goto done;
+    }
     
-    // Unrolled merge loop for better performance
-    while (i < n1 && j < n2) {
-        // Process 4 elements at a time when possible
-        if (i + 3 < n1 && j + 3 < n2) {
-            arr[k++] = (L[i] <= R[j]) ? L[i++] : R[j++];
-            arr[k++] = (L[i] <= R[j]) ? L[i++] : R[j++];
-            arr[k++] = (L[i] <= R[j]) ? L[i++] : R[j++];
-            arr[k++] = (L[i] <= R[j]) ? L[i++] : R[j++];
-        } else {
-            arr[k++] = (L[i] <= R[j]) ? L[i++] : R[j++];
+    const void *src[3] = {keys, values, ids};
+    void *dst[3] = {keys_out, values_out, ids_out};
+    const size_t sizes[3] = {sizeof(int32_t), sizeof(double), sizeof(int32_t)};
+    
+    start_time = omp_get_wtime();
+    psort_gather(perm, size, 3, src, dst, sizes);
+    double gather_time = omp_get_wtime() - start_time;
+    
+    printf("Argsort (packed 64-bit pairs): %.6f seconds\n", argsort_time);
+    printf("Gather of 3 columns:           %.6f seconds\n", gather_time);
+    
+    // Sorted keys, ties in row order, and every row moved as a whole
+    ok = 1;
+    #pragma omp parallel for reduction(&&:ok)
+    for (int i = 0; i < size; i++) {
+        int row_ok = ids_out[i] == (int32_t)perm[i] && values_out[i] == values[perm[i]];
+        if (i > 0) {
+            row_ok = row_ok && (keys_out[i - 1] < keys_out[i] ||
+                                (keys_out[i - 1] == keys_out[i] && ids_out[i - 1] < ids_out[i]));
         }
+        ok = ok && row_ok;
     }
     
-    // Copy remaining elements using memcpy for efficiency
-    if (i < n1) {
-        memcpy(&arr[k], &L[i], (n1 - i) * sizeof(int));
+    printf(ok ? "\n✓ Rows sorted by key, stable, with every column permuted together!\n"
+              : "\n✗ Error: Argsort results are wrong!\n");
+
+done:
+    free(keys);
+    free(values);
+    free(ids);
+    free(perm);
+    free(keys_out);
+    free(values_out);
+    free(ids_out);
+    return ok ? 0 : 1;
+}
+
+// ----- Selection demo (--select) -----
+
+// Times top_k, nth_element and partial_sort for one k against a full sort
+// of the same input, and checks each against the fully sorted array
+int run_select_demo(int size, int k, uint64_t seed) {
+    if (k > size) k = size;
+    
+    int *input = (int*)malloc((size_t)size * sizeof(int));
+    int *sorted = (int*)malloc((size_t)size * sizeof(int));
+    int *work = (int*)malloc((size_t)size * sizeof(int));
+    int *top = (int*)malloc((size_t)k * sizeof(int));
+    if (input == NULL || sorted == NULL || work == NULL || top == NULL) {
+        printf("Error: Memory allocation failed\n");
+        free(input);
+        free(sorted);
+        free(work);
+        free(top);
+        return 1;
     }
-    if (j < n2) {
-        memcpy(&arr[k], &R[j], (n2 - j) * sizeof(int));
+    
+    generate_random_array(input, size, seed);
+    printf("\n----- Selection: k = %d of %d elements -----\n", k, size);
+    printf("Using %d threads\n\n", omp_get_max_threads());
+    
+    sort_verbose = 0;
+    memcpy(sorted, input, (size_t)size * sizeof(int));
+    double start_time = omp_get_wtime();
+    parallel_merge_sort(sorted, size);
+    double sort_time = omp_get_wtime() - start_time;
+    
+    start_time = omp_get_wtime();
+    int rc = parallel_top_k(input, size, k, top);
+    double top_time = omp_get_wtime() - start_time;
+    int top_ok = (rc == 0 && memcmp(top, sorted, (size_t)k * sizeof(int)) == 0);
+    
+    memcpy(work, input, (size_t)size * sizeof(int));
+    start_time = omp_get_wtime();
+    parallel_nth_element(work, size, k - 1);
+    double nth_time = omp_get_wtime() - start_time;
+    int nth_ok = (work[k - 1] == sorted[k - 1]);
+    for (int i = 0; i < size && nth_ok; i++) {
+        nth_ok = (i < k - 1) ? work[i] <= work[k - 1] : work[i] >= work[k - 1];
     }
     
-    // Free only if heap allocated
-    if (n1 > 1024 || n2 > 1024) {
-        free(L);
-        free(R);
+    memcpy(work, input, (size_t)size * sizeof(int));
+    start_time = omp_get_wtime();
+    parallel_partial_sort(work, size, k);
+    double partial_time = omp_get_wtime() - start_time;
+    int partial_ok = (memcmp(work, sorted, (size_t)k * sizeof(int)) == 0);
+    sort_verbose = 1;
+    
+    printf("%-14s %12s %10s\n", "Operation", "Time (s)", "vs sort");
+    printf("%-14s %12.6f %10s\n", "full sort", sort_time, "1.00x");
+    printf("%-14s %12.6f %9.2fx %s\n", "top_k", top_time, top_time > 0 ? sort_time / top_time : 0.0,
+           top_ok ? "" : "WRONG");
+    printf("%-14s %12.6f %9.2fx %s\n", "nth_element", nth_time, nth_time > 0 ? sort_time / nth_time : 0.0,
+           nth_ok ? "" : "WRONG");
+    printf("%-14s %12.6f %9.2fx %s\n", "partial_sort", partial_time,
+           partial_time > 0 ? sort_time / partial_time : 0.0, partial_ok ? "" : "WRONG");
+    
+    int ok = top_ok && nth_ok && partial_ok;
+    printf(ok ? "\n✓ All selections match the fully sorted array!\n"
+              : "\n✗ Error: Selection results are wrong!\n");
+    
+    free(input);
+    free(sorted);
+    free(work);
+    free(top);
+    return ok ? 0 : 1;
+}
+
+// ----- Benchmark suite (--bench) -----
+
+// Every engine sorts byte-identical copies of each input, generated once per
+// (distribution, size) from the seed. Each configuration is timed --reps
+// times and reported as the median (and best) in CSV or JSON.
+
+#define BENCH_MAX_LIST 16
+// Zipf inputs draw from this many distinct values, with P(k) ~ 1/k
+#define ZIPF_VALUES 65536
+
+typedef struct {
+    const char *name;
+    void (*fill)(int arr[], int size, uint64_t seed);
+} BenchDistribution;
+
+static void fill_uniform(int arr[], int size, uint64_t seed) {
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < size; i++) {
+        arr[i] = (int)random_below(random_at(seed, i), INT_MAX);
     }
 }
 
-// Sequential merge sort (for small arrays or when task depth is too high)
-void merge_sort_sequential(int arr[], int left, int right) {
-    if (left < right) {
-        int mid = left + (right - left) / 2;
-        
-        // Sort first and second halves
-        merge_sort_sequential(arr, left, mid);
-        merge_sort_sequential(arr, mid + 1, right);
-        
-        // Merge the sorted halves
-        merge(arr, left, mid, right);
+static void fill_few_unique(int arr[], int size, uint64_t seed) {
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < size; i++) {
+        arr[i] = (int)random_below(random_at(seed, i), 16) * 1000;
     }
 }
 
-// Parallel merge sort using OpenMP tasks with depth control (optimized)
-void merge_sort_parallel_helper(int arr[], int left, int right, int depth) {
-    if (left >= right) return;
+static void fill_sorted(int arr[], int size, uint64_t seed) {
+    (void)seed;
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < size; i++) {
+        arr[i] = i;
+    }
+}
+
+static void fill_reverse(int arr[], int size, uint64_t seed) {
+    (void)seed;
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < size; i++) {
+        arr[i] = size - i;
+    }
+}
+
+// Ascending to the middle, then descending
+static void fill_organ_pipe(int arr[], int size, uint64_t seed) {
+    (void)seed;
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < size; i++) {
+        arr[i] = (i < size / 2) ? i : size - i;
+    }
+}
+
+// Zipf (s = 1) over ZIPF_VALUES values: inverse CDF by binary search
+static void fill_zipf(int arr[], int size, uint64_t seed) {
+    double *cdf = (double*)malloc(ZIPF_VALUES * sizeof(double));
+    if (cdf == NULL) {
+        fill_uniform(arr, size, seed);
+        return;
+    }
     
-    int size = right - left + 1;
+    double sum = 0.0;
+    for (int k = 0; k < ZIPF_VALUES; k++) {
+        sum += 1.0 / (k + 1);
+        cdf[k] = sum;
+    }
     
-    // Use sequential sort for small arrays or when task depth is too high
-    if (size < PARALLEL_THRESHOLD || depth >= MAX_TASK_DEPTH) {
-        merge_sort_sequential(arr, left, right);
-        return;
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < size; i++) {
+        double u = (double)(random_at(seed, i) >> 11) * (1.0 / 9007199254740992.0) * sum;
+        int lo = 0, hi = ZIPF_VALUES - 1;
+        while (lo < hi) {
+            int m = lo + (hi - lo) / 2;
+            if (cdf[m] <= u) lo = m + 1; else hi = m;
+        }
+        arr[i] = lo;
     }
     
-    int mid = left + (right - left) / 2;
+    free(cdf);
+}
+
+// Full 32-bit key range, negatives included: the widest keys the int
+// engines take, and the worst case for radix (four 8-bit passes)
+static void fill_wide(int arr[], int size, uint64_t seed) {
+    #pragma omp parallel for schedule(static)
+    for (int i = 0; i < size; i++) {
+        arr[i] = (int)(uint32_t)random_at(seed, i);
+    }
+}
+
+static const BenchDistribution bench_distributions[] = {
+    {"uniform", fill_uniform},
+    {"few_unique", fill_few_unique},
+    {"sorted", fill_sorted},
+    {"reverse", fill_reverse},
+    {"organ_pipe", fill_organ_pipe},
+    {"zipf", fill_zipf},
+    {"wide", fill_wide},
+};
+#define NUM_BENCH_DISTRIBUTIONS ((int)(sizeof(bench_distributions) / sizeof(bench_distributions[0])))
+
+typedef struct {
+    int sizes[BENCH_MAX_LIST];
+    int num_sizes;
+    int threads[BENCH_MAX_LIST];
+    int num_threads;
+    const char *dists;   // comma separated names, NULL for all
+    int reps;
+    int json;
+    const char *out_path;
+    uint64_t seed;
+} BenchOptions;
+
+// Parses "a,b,c" into positive ints; returns the count, or -1 if malformed
+static int parse_int_list(const char *text, int values[], int max_values) {
+    int count = 0;
+    while (*text != '\0') {
+        char *end;
+        long v = strtol(text, &end, 10);
+        if (end == text || v <= 0 || v > INT_MAX || count == max_values) return -1;
+        values[count++] = (int)v;
+        text = (*end == ',') ? end + 1 : end;
+        if (*end != ',' && *end != '\0') return -1;
+    }
+    return count;
+}
+
+// 1 if name appears in the comma separated list
+static int list_contains(const char *list, const char *name) {
+    size_t len = strlen(name);
+    for (const char *p = list; p != NULL; p = strchr(p, ',')) {
+        if (*p == ',') p++;
+        if (strncmp(p, name, len) == 0 && (p[len] == ',' || p[len] == '\0')) return 1;
+    }
+    return 0;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+int run_benchmark_suite(BenchOptions *opt) {
+    int max_size = 0;
+    for (int s = 0; s < opt->num_sizes; s++) {
+        if (opt->sizes[s] > max_size) max_size = opt->sizes[s];
+    }
     
-    // Create untied tasks for better work stealing and load balancing
-    #pragma omp task shared(arr) firstprivate(left, mid, depth) untied if(depth < MAX_TASK_DEPTH - 1)
-    {
-        merge_sort_parallel_helper(arr, left, mid, depth + 1);
+    // Default thread counts: powers of two up to the machine, plus the machine
+    if (opt->num_threads == 0) {
+        int max_threads = omp_get_max_threads();
+        for (int t = 1; t < max_threads && opt->num_threads < BENCH_MAX_LIST - 1; t *= 2) {
+            opt->threads[opt->num_threads++] = t;
+        }
+        opt->threads[opt->num_threads++] = max_threads;
     }
     
-    #pragma omp task shared(arr) firstprivate(mid, right, depth) untied if(depth < MAX_TASK_DEPTH - 1)
-    {
-        merge_sort_parallel_helper(arr, mid + 1, right, depth + 1);
+    if (opt->dists != NULL) {
+        for (const char *p = opt->dists; p != NULL; p = strchr(p + 1, ',')) {
+            const char *name = (*p == ',') ? p + 1 : p;
+            size_t len = strcspn(name, ",");
+            int known = 0;
+            for (int d = 0; d < NUM_BENCH_DISTRIBUTIONS; d++) {
+                known |= (strlen(bench_distributions[d].name) == len &&
+                          strncmp(bench_distributions[d].name, name, len) == 0);
+            }
+            if (!known) {
+                printf("Error: Unknown distribution '%.*s'\n", (int)len, name);
+                return 1;
+            }
+        }
     }
     
-    // Wait for both tasks to complete before merging
-    #pragma omp taskwait
+    FILE *out = stdout;
+    if (opt->out_path != NULL) {
+        out = fopen(opt->out_path, "w");
+        if (out == NULL) {
+            printf("Error: Cannot create '%s'\n", opt->out_path);
+            return 1;
+        }
+    }
+    
+    int *input = (int*)malloc((size_t)max_size * sizeof(int));
+    int *work = (int*)malloc((size_t)max_size * sizeof(int));
+    double *times = (double*)malloc(opt->reps * sizeof(double));
+    if (input == NULL || work == NULL || times == NULL) {
+        printf("Error: Memory allocation failed\n");
+        if (out != stdout) fclose(out);
+        free(input);
+        free(work);
+        free(times);
+        return 1;
+    }
+    
+    fprintf(stderr, "Benchmark suite: seed %llu, median of %d run(s)\n",
+            (unsigned long long)opt->seed, opt->reps);
+    if (opt->json) {
+        fprintf(out, "[\n");
+    } else {
+        fprintf(out, "engine,distribution,size,threads,reps,median_s,best_s,elements_per_s,verified\n");
+    }
+    
+    int rows = 0, failures = 0;
+    sort_verbose = 0;
+    
+    for (int d = 0; d < NUM_BENCH_DISTRIBUTIONS; d++) {
+        const BenchDistribution *dist = &bench_distributions[d];
+        if (opt->dists != NULL && !list_contains(opt->dists, dist->name)) continue;
+        
+        for (int s = 0; s < opt->num_sizes; s++) {
+            int size = opt->sizes[s];
+            dist->fill(input, size, opt->seed);
+            uint64_t checksum = array_checksum(input, size);
+            
+            for (int t = 0; t < opt->num_threads; t++) {
+                omp_set_num_threads(opt->threads[t]);
+                
+                for (size_t e = 0; e < sizeof(sort_engines) / sizeof(sort_engines[0]); e++) {
+                    const SortEngine *engine = &sort_engines[e];
+                    int verified = 1;
+                    
+                    for (int r = 0; r < opt->reps; r++) {
+                        memcpy(work, input, (size_t)size * sizeof(int));
+                        double start = omp_get_wtime();
+                        engine->sort(work, size);
+                        times[r] = omp_get_wtime() - start;
+                        
+                        if (r == 0) {
+                            verified = is_sorted(work, size) && array_checksum(work, size) == checksum;
+                        }
+                    }
+                    
+                    qsort(times, opt->reps, sizeof(double), compare_doubles);
+                    double median = (opt->reps % 2) ? times[opt->reps / 2]
+                                  : 0.5 * (times[opt->reps / 2 - 1] + times[opt->reps / 2]);
+                    double rate = (median > 0) ? size / median : 0.0;
+                    failures += !verified;
+                    
+                    if (opt->json) {
+                        fprintf(out, "%s  {\"engine\": \"%s\", \"distribution\": \"%s\", \"size\": %d, "
+                                "\"threads\": %d, \"reps\": %d, \"median_s\": %.6f, \"best_s\": %.6f, "
+                                "\"elements_per_s\": %.0f, \"verified\": %s}",
+                                rows ? ",\n" : "", engine->name, dist->name, size, opt->threads[t],
+                                opt->reps, median, times[0], rate, verified ? "true" : "false");
+                    } else {
+                        fprintf(out, "%s,%s,%d,%d,%d,%.6f,%.6f,%.0f,%d\n", engine->name, dist->name,
+                                size, opt->threads[t], opt->reps, median, times[0], rate, verified);
+                    }
+                    fflush(out);
+                    rows++;
+                    
+                    fprintf(stderr, "  %-10s %-11s %10d x%-3d %10.6f s %8.1f Melem/s%s\n", engine->name,
+                            dist->name, size, opt->threads[t], median, rate / 1e6,
+                            verified ? "" : "  NOT SORTED");
+                }
+            }
+        }
+    }
     
-    // Merge the sorted halves
-    merge(arr, left, mid, right);
+    sort_verbose = 1;
+    if (opt->json) fprintf(out, "\n]\n");
+    if (out != stdout) fclose(out);
+    free(input);
+    free(work);
+    free(times);
+    
+    if (failures > 0) {
+        fprintf(stderr, "\n✗ Error: %d configuration(s) produced wrong output!\n", failures);
+        return 1;
+    }
+    fprintf(stderr, "\n✓ All %d configuration(s) verified\n", rows);
+    return 0;
 }
 
-// Parallel merge sort using OpenMP tasks
-void merge_sort_parallel(int arr[], int left, int right) {
-    merge_sort_parallel_helper(arr, left, right, 0);
+// ----- External sort (--external) -----
+
+// Key files are flat arrays of native-endian 32-bit ints. Inputs larger
+// than the memory budget are cut into runs that fit, each run is sorted by
+// the selected engine and spilled to a temporary file, and the runs are
+// then merged with a loser tree through large sequential I/O buffers.
+
+// Most runs merged in one pass; more runs need intermediate passes
+#define EXTERNAL_MAX_FANIN 128
+// Smallest per-run read buffer (256 KB of keys) before the fan-in is reduced
+#define EXTERNAL_MIN_IO_ELEMS (64 * 1024)
+
+// 64-bit file offsets on every platform
+#ifdef _WIN32
+#define file_seek _fseeki64
+#define file_tell _ftelli64
+#else
+#define file_seek fseeko
+#define file_tell ftello
+#endif
+
+// Buffered reader over one sorted run of a run file
+typedef struct {
+    FILE *file;
+    long long remaining;   // keys of this run not yet read
+    int *buf;
+    size_t len;
+    size_t pos;
+} RunReader;
+
+// Reads the next block of the run; len is 0 once the run is exhausted
+static int run_reader_fill(RunReader *r, size_t cap) {
+    size_t want = (r->remaining < (long long)cap) ? (size_t)r->remaining : cap;
+    
+    r->len = fread(r->buf, sizeof(int), want, r->file);
+    r->pos = 0;
+    r->remaining -= (long long)r->len;
+    return (r->len == want) ? 0 : -1;
 }
 
-// Wrapper function to initiate parallel merge sort with optimized task creation
-void parallel_merge_sort(int arr[], int size) {
-    #pragma omp parallel
-    {
-        #pragma omp single nowait
-        {
-            printf("\n----- Starting Parallel Merge Sort -----\n");
-            printf("Using %d threads\n\n", omp_get_num_threads());
-            
-            // Use untied tasks for better work stealing
-            #pragma omp task untied
-            merge_sort_parallel(arr, 0, size - 1);
+// Merges the k runs stored at run_start[]/run_len[] (in keys) of the file
+// at path into out. Every run gets its own handle and io_elems-key buffer.
+static int merge_run_files(const char *path, const long long *run_start, const long long *run_len,
+                           int k, FILE *out, size_t io_elems) {
+    RunReader *readers = (RunReader*)calloc(k, sizeof(RunReader));
+    int *out_buf = (int*)malloc(io_elems * sizeof(int));
+    psort_loser_tree_t lt;
+    int status = -1;
+    
+    if (readers == NULL || out_buf == NULL || psort_loser_tree_init(&lt, k) != 0) {
+        printf("Error: Memory allocation failed\n");
+        free(readers);
+        free(out_buf);
+        return -1;
+    }
+    
+    for (int s = 0; s < k; s++) {
+        RunReader *r = &readers[s];
+        r->file = fopen(path, "rb");
+        r->buf = (int*)malloc(io_elems * sizeof(int));
+        r->remaining = run_len[s];
+        if (r->file == NULL || r->buf == NULL ||
+            file_seek(r->file, run_start[s] * (long long)sizeof(int), SEEK_SET) != 0 ||
+            run_reader_fill(r, io_elems) != 0) {
+            printf("Error: Cannot read run %d of '%s'\n", s, path);
+            goto cleanup;
         }
+        lt.keys[s] = (r->len > 0) ? psort_loser_tree_key(r->buf[0], s) : PSORT_LOSER_TREE_DONE;
+    }
+    psort_loser_tree_build(&lt);
+    
+    size_t out_len = 0;
+    while (lt.keys[lt.tree[0]] != PSORT_LOSER_TREE_DONE) {
+        int s = lt.tree[0];
+        RunReader *r = &readers[s];
+        
+        out_buf[out_len++] = r->buf[r->pos];
+        if (out_len == io_elems) {
+            if (fwrite(out_buf, sizeof(int), out_len, out) != out_len) {
+                printf("Error: Write failed\n");
+                goto cleanup;
+            }
+            out_len = 0;
+        }
+        
+        if (++r->pos == r->len && run_reader_fill(r, io_elems) != 0) {
+            printf("Error: Cannot read run %d of '%s'\n", s, path);
+            goto cleanup;
+        }
+        lt.keys[s] = (r->len > 0) ? psort_loser_tree_key(r->buf[r->pos], s) : PSORT_LOSER_TREE_DONE;
+        psort_loser_tree_replay(&lt);
+    }
+    
+    if (fwrite(out_buf, sizeof(int), out_len, out) != out_len) {
+        printf("Error: Write failed\n");
+        goto cleanup;
     }
+    status = 0;
+
+cleanup:
+    for (int s = 0; s < k; s++) {
+        if (readers[s].file != NULL) fclose(readers[s].file);
+        free(readers[s].buf);
+    }
+    psort_loser_tree_free(&lt);
+    free(readers);
+    free(out_buf);
+    return status;
 }
 
-// Function to print array
-void print_array(int arr[], int size, int max_elements) {
-    int print_count = (size < max_elements) ? size : max_elements;
+// Streams a key file once and checks it holds expected_n keys in order;
+// *checksum receives the file's array_checksum for the permutation check
+static int verify_key_file(const char *path, long long expected_n, uint64_t *checksum) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) return 0;
     
-    for (int i = 0; i < print_count; i++) {
-        printf("%d ", arr[i]);
+    int *buf = (int*)malloc(EXTERNAL_MIN_IO_ELEMS * sizeof(int));
+    if (buf == NULL) {
+        fclose(f);
+        return 0;
     }
     
-    if (size > max_elements) {
-        printf("... (%d more elements)", size - max_elements);
+    long long count = 0;
+    int prev = INT_MIN, ok = 1;
+    size_t got;
+    *checksum = 0;
+    while (ok && (got = fread(buf, sizeof(int), EXTERNAL_MIN_IO_ELEMS, f)) > 0) {
+        for (size_t i = 0; i < got; i++) {
+            if (buf[i] < prev) ok = 0;
+            prev = buf[i];
+        }
+        *checksum += array_checksum(buf, (int)got);
+        count += (long long)got;
     }
-    printf("\n");
+    
+    free(buf);
+    fclose(f);
+    return ok && count == expected_n;
 }
 
-// Function to verify if array is sorted
-int is_sorted(int arr[], int size) {
-    for (int i = 0; i < size - 1; i++) {
-        if (arr[i] > arr[i + 1]) {
-            return 0;
+// Writes count random keys to path (test input for --external)
+int make_key_file(const char *path, long long count, uint64_t seed) {
+    FILE *f = fopen(path, "wb");
+    int *buf = (int*)malloc(EXTERNAL_MIN_IO_ELEMS * sizeof(int));
+    if (f == NULL || buf == NULL) {
+        printf("Error: Cannot create key file '%s'\n", path);
+        if (f != NULL) fclose(f);
+        free(buf);
+        return 1;
+    }
+    
+    for (long long done = 0; done < count; ) {
+        int n = (count - done < EXTERNAL_MIN_IO_ELEMS) ? (int)(count - done) : EXTERNAL_MIN_IO_ELEMS;
+        
+        #pragma omp parallel for schedule(static)
+        for (int i = 0; i < n; i++) {
+            buf[i] = (int)(uint32_t)random_at(seed, (uint64_t)(done + i));
+        }
+        if (fwrite(buf, sizeof(int), n, f) != (size_t)n) {
+            printf("Error: Write to '%s' failed\n", path);
+            fclose(f);
+            free(buf);
+            return 1;
         }
+        done += (long long)n;
     }
-    return 1;
+    
+    printf("Wrote %lld random keys (%.1f MB, seed %llu) to %s\n", count, count * sizeof(int) / 1e6,
+           (unsigned long long)seed, path);
+    fclose(f);
+    free(buf);
+    return 0;
 }
 
-// Function to generate random array
-void generate_random_array(int arr[], int size) {
-    for (int i = 0; i < size; i++) {
-        arr[i] = rand() % 10000;
+// Sorts the key file input into output using at most about mem_bytes of RAM
+int external_sort(const char *input, const char *output, size_t mem_bytes, const SortEngine *engine) {
+    FILE *in = fopen(input, "rb");
+    if (in == NULL) {
+        printf("Error: Cannot open input file '%s'\n", input);
+        return 1;
+    }
+    
+    file_seek(in, 0, SEEK_END);
+    long long bytes = file_tell(in);
+    file_seek(in, 0, SEEK_SET);
+    long long n = bytes / (long long)sizeof(int);
+    
+    // The budget holds the run plus whatever scratch the engine allocates per key
+    size_t run_elems = mem_bytes / (sizeof(int) + engine->scratch_bytes);
+    if (run_elems > INT_MAX) run_elems = INT_MAX;
+    if ((long long)run_elems > n) run_elems = (size_t)n;
+    if (run_elems < 1) run_elems = 1;
+    
+    int nruns = (int)((n + (long long)run_elems - 1) / (long long)run_elems);
+    int *buf = (int*)malloc(run_elems * sizeof(int));
+    long long *run_start = (long long*)malloc((nruns + 1) * sizeof(long long));
+    long long *run_len = (long long*)malloc((nruns + 1) * sizeof(long long));
+    if (buf == NULL || run_start == NULL || run_len == NULL) {
+        printf("Error: Memory allocation failed\n");
+        fclose(in);
+        free(buf);
+        free(run_start);
+        free(run_len);
+        return 1;
+    }
+    
+    printf("\n----- External Sort -----\n");
+    printf("Input: %s (%lld keys, %.1f MB)\n", input, n, bytes / 1e6);
+    if (bytes % (long long)sizeof(int)) {
+        printf("Warning: ignoring %lld trailing byte(s)\n", bytes % (long long)sizeof(int));
+    }
+    printf("Memory budget: %zu MB -> %d run(s) of up to %zu keys, sorted by the %s engine (%zu bytes per key)\n",
+           mem_bytes >> 20, nruns, run_elems, engine->name, sizeof(int) + engine->scratch_bytes);
+    printf("Using %d threads\n\n", omp_get_max_threads());
+    
+    // Run files alternate between two temporary paths next to the output
+    char tmp_path[2][1024];
+    snprintf(tmp_path[0], sizeof(tmp_path[0]), "%s.run0.tmp", output);
+    snprintf(tmp_path[1], sizeof(tmp_path[1]), "%s.run1.tmp", output);
+    
+    double start_time = omp_get_wtime();
+    uint64_t checksum = 0, out_checksum;
+    int status = 1;
+    
+    // Phase 1: sort memory-sized runs; a single run goes straight to the output
+    FILE *runs = fopen(nruns > 1 ? tmp_path[0] : output, "wb");
+    if (runs == NULL) {
+        printf("Error: Cannot create '%s'\n", nruns > 1 ? tmp_path[0] : output);
+        goto done;
+    }
+    
+    sort_verbose = 0;
+    for (int r = 0; r < nruns; r++) {
+        run_start[r] = (long long)r * (long long)run_elems;
+        run_len[r] = (n - run_start[r] < (long long)run_elems) ? n - run_start[r] : (long long)run_elems;
+        
+        if (fread(buf, sizeof(int), (size_t)run_len[r], in) != (size_t)run_len[r]) {
+            printf("Error: Read from '%s' failed\n", input);
+            fclose(runs);
+            goto done;
+        }
+        checksum += array_checksum(buf, (int)run_len[r]);
+        engine->sort(buf, (int)run_len[r]);
+        if (fwrite(buf, sizeof(int), (size_t)run_len[r], runs) != (size_t)run_len[r]) {
+            printf("Error: Write failed\n");
+            fclose(runs);
+            goto done;
+        }
+    }
+    sort_verbose = 1;
+    fclose(runs);
+    free(buf);
+    buf = NULL;
+    
+    double run_time = omp_get_wtime() - start_time;
+    printf("Run formation: %d run(s) in %.3f seconds\n", nruns, run_time);
+    
+    // Phase 2: merge passes. The whole budget is split into one read buffer
+    // per merged run plus one output buffer; lower the fan-in rather than
+    // let the buffers shrink below EXTERNAL_MIN_IO_ELEMS.
+    size_t budget_elems = mem_bytes / sizeof(int);
+    int fanin = (nruns < EXTERNAL_MAX_FANIN) ? nruns : EXTERNAL_MAX_FANIN;
+    if (budget_elems / (fanin + 1) < EXTERNAL_MIN_IO_ELEMS) {
+        fanin = (int)(budget_elems / EXTERNAL_MIN_IO_ELEMS) - 1;
+        if (fanin < 2) fanin = 2;
+    }
+    size_t io_elems = budget_elems / (fanin + 1);
+    if (io_elems < 1024) io_elems = 1024;
+    
+    int src = 0, passes = 0;
+    while (nruns > 1) {
+        int final = (nruns <= fanin);
+        FILE *out = fopen(final ? output : tmp_path[1 - src], "wb");
+        if (out == NULL) {
+            printf("Error: Cannot create '%s'\n", final ? output : tmp_path[1 - src]);
+            goto done;
+        }
+        
+        // Merge groups of up to fanin runs; group g becomes run g of the next pass
+        int groups = 0;
+        long long offset = 0;
+        for (int r = 0; r < nruns; r += fanin, groups++) {
+            int k = (nruns - r < fanin) ? nruns - r : fanin;
+            long long total = 0;
+            for (int s = 0; s < k; s++) total += run_len[r + s];
+            
+            if (merge_run_files(tmp_path[src], &run_start[r], &run_len[r], k, out, io_elems) != 0) {
+                fclose(out);
+                goto done;
+            }
+            run_start[groups] = offset;
+            run_len[groups] = total;
+            offset += total;
+        }
+        
+        fclose(out);
+        passes++;
+        printf("Merge pass %d: %d run(s) -> %d (%d-way loser tree, %zu KB buffers)\n",
+               passes, nruns, groups, fanin < nruns ? fanin : nruns, io_elems * sizeof(int) >> 10);
+        nruns = groups;
+        src = 1 - src;
+    }
+    
+    double total_time = omp_get_wtime() - start_time;
+    printf("Merge phase: %d pass(es) in %.3f seconds\n", passes, total_time - run_time);
+    printf("\nTime taken: %.6f seconds (%.1f MB/s)\n", total_time,
+           total_time > 0 ? bytes / 1e6 / total_time : 0.0);
+    
+    // Sorted, complete and still the same multiset of keys as the input
+    if (verify_key_file(output, n, &out_checksum)) {
+        printf("\n✓ Output file is correctly sorted!\n");
+        if (out_checksum == checksum) {
+            printf("✓ Output is a permutation of the input (checksum %016llx)\n", (unsigned long long)checksum);
+            status = 0;
+        } else {
+            printf("✗ Error: Output is NOT a permutation of the input (checksum mismatch)!\n");
+        }
+    } else {
+        printf("\n✗ Error: Output file is NOT sorted correctly!\n");
     }
+
+done:
+    sort_verbose = 1;
+    remove(tmp_path[0]);
+    remove(tmp_path[1]);
+    fclose(in);
+    free(buf);
+    free(run_start);
+    free(run_len);
+    return status;
 }
 
 int main(int argc, char *argv[]) {
-    int size;
+    int size = 0;
     int *arr;
     double start_time, end_time;
+    const SortEngine *engine = find_sort_engine("merge");
+    const char *type = NULL;
+    const char *ext_input = NULL, *ext_output = NULL;
+    const char *keys_path = NULL;
+    long long keys_count = 0;
+    size_t mem_mb = 256;
+    uint64_t seed = (uint64_t)time(NULL);
+    int bench = 0, argsort = 0, select_k = 0;
+    BenchOptions bench_opt = {{1000000, 10000000}, 2, {0}, 0, NULL, 5, 0, NULL, 0};
     
-    // Get array size from command line or use default
-    if (argc > 1) {
-        size = atoi(argv[1]);
-        if (size <= 0) {
-            printf("Error: Size must be positive\n");
-            return 1;
+    // Parse options; the first plain argument is the array size
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--bench-merge") == 0) {
+            return bench_merge_kernels();
+        } else if (strcmp(argv[i], "--select") == 0 && i + 1 < argc) {
+            select_k = atoi(argv[++i]);
+            if (select_k <= 0) {
+                printf("Error: k must be positive\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--argsort") == 0) {
+            argsort = 1;
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            bench = 1;
+        } else if (strcmp(argv[i], "--sizes") == 0 && i + 1 < argc) {
+            bench_opt.num_sizes = parse_int_list(argv[++i], bench_opt.sizes, BENCH_MAX_LIST);
+            if (bench_opt.num_sizes <= 0) {
+                printf("Error: --sizes expects a comma separated list of positive sizes\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            bench_opt.num_threads = parse_int_list(argv[++i], bench_opt.threads, BENCH_MAX_LIST);
+            if (bench_opt.num_threads <= 0) {
+                printf("Error: --threads expects a comma separated list of thread counts\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--dist") == 0 && i + 1 < argc) {
+            bench_opt.dists = argv[++i];
+        } else if (strcmp(argv[i], "--reps") == 0 && i + 1 < argc) {
+            bench_opt.reps = atoi(argv[++i]);
+            if (bench_opt.reps <= 0) {
+                printf("Error: --reps must be positive\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--format") == 0 && i + 1 < argc) {
+            i++;
+            if (strcmp(argv[i], "csv") != 0 && strcmp(argv[i], "json") != 0) {
+                printf("Error: Unknown format '%s' (use csv or json)\n", argv[i]);
+                return 1;
+            }
+            bench_opt.json = (strcmp(argv[i], "json") == 0);
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            bench_opt.out_path = argv[++i];
+        } else if (strcmp(argv[i], "--make-keys") == 0 && i + 2 < argc) {
+            keys_path = argv[++i];
+            keys_count = atoll(argv[++i]);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--external") == 0 && i + 2 < argc) {
+            ext_input = argv[++i];
+            ext_output = argv[++i];
+        } else if (strcmp(argv[i], "--mem") == 0 && i + 1 < argc) {
+            mem_mb = strtoul(argv[++i], NULL, 10);
+            if (mem_mb == 0) {
+                printf("Error: Memory budget must be at least 1 MB\n");
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            engine = find_sort_engine(argv[++i]);
+            if (engine == NULL) {
+                printf("Error: Unknown engine '%s' (use merge, radix, sample or sequential)\n", argv[i]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--type") == 0 && i + 1 < argc) {
+            type = argv[++i];
+        } else {
+            size = atoi(argv[i]);
+            if (size <= 0) {
+                printf("Error: Size must be positive\n");
+                return 1;
+            }
         }
-    } else {
+    }
+    
+    if (bench) {
+        bench_opt.seed = seed;
+        return run_benchmark_suite(&bench_opt);
+    }
+    if (keys_path != NULL) {
+        return make_key_file(keys_path, keys_count, seed);
+    }
+    if (ext_input != NULL) {
+        return external_sort(ext_input, ext_output, mem_mb << 20, engine);
+    }
+    
+    // Ask for the array size if it was not given
+    if (size == 0) {
         printf("Enter array size: ");
         scanf("%d", &size);
         
@@ -182,6 +2569,16 @@ int main(int argc, char *argv[]) {
         }
     }
     
+    if (type != NULL) {
+        return run_typed_sort(type, size);
+    }
+    if (argsort) {
+        return run_argsort_demo(size, seed);
+    }
+    if (select_k > 0) {
+        return run_select_demo(size, select_k, seed);
+    }
+    
     // Allocate memory for array
     arr = (int*)malloc(size * sizeof(int));
     if (arr == NULL) {
@@ -189,19 +2586,17 @@ int main(int argc, char *argv[]) {
         return 1;
     }
     
-    // Seed random number generator
-    srand(time(NULL));
-    
-    // Generate random array
-    printf("Generating random array of size %d...\n", size);
-    generate_random_array(arr, size);
+    // Generate random array; --seed reproduces a previous run
+    printf("Generating random array of size %d (seed %llu)...\n", size, (unsigned long long)seed);
+    generate_random_array(arr, size, seed);
+    uint64_t checksum = array_checksum(arr, size);
     
     printf("\nOriginal array (first 20 elements): ");
     print_array(arr, size, 20);
     
-    // Perform parallel merge sort and measure time
+    // Perform the parallel sort and measure time
     start_time = omp_get_wtime();
-    parallel_merge_sort(arr, size);
+    engine->sort(arr, size);
     end_time = omp_get_wtime();
     
     double parallel_time = end_time - start_time;
@@ -210,22 +2605,31 @@ int main(int argc, char *argv[]) {
     printf("Sorted array (first 20 elements): ");
     print_array(arr, size, 20);
     
-    // Verify if array is sorted
+    // Verify that the array is sorted and still holds the same values
     if (is_sorted(arr, size)) {
         printf("\n✓ Array is correctly sorted!\n");
     } else {
         printf("\n✗ Error: Array is NOT sorted correctly!\n");
     }
+    if (array_checksum(arr, size) == checksum) {
+        printf("✓ Output is a permutation of the input (checksum %016llx)\n", (unsigned long long)checksum);
+    } else {
+        printf("✗ Error: Output is NOT a permutation of the input (checksum mismatch)!\n");
+    }
     
     printf("\nTime taken: %.6f seconds\n", parallel_time);
     
     // Performance comparison with sequential sort
     printf("\n----- Comparing with Sequential Sort -----\n");
     
-    // Generate another random array for comparison
+    // Regenerate the same input from the seed for the sequential run
     int *arr_seq = (int*)malloc(size * sizeof(int));
-    memcpy(arr_seq, arr, size * sizeof(int));
-    generate_random_array(arr_seq, size);
+    if (arr_seq == NULL) {
+        printf("Error: Memory allocation failed\n");
+        free(arr);
+        return 1;
+    }
+    generate_random_array(arr_seq, size, seed);
     
     start_time = omp_get_wtime();
     merge_sort_sequential(arr_seq, 0, size - 1);
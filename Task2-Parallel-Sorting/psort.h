@@ -0,0 +1,658 @@
+/**
+ * psort.h - Parallel merge sort library (header only)
+ *
+ * Generic API, same calling convention as qsort():
+ *
+ *   int psort(void *base, size_t n, size_t elem_size, psort_cmp_fn cmp);
+ *
+ * Type-specialised variants, where the comparison is inlined instead of
+ * being called through a function pointer:
+ *
+ *   int psort_i32(int32_t *base, size_t n);
+ *   int psort_u32(uint32_t *base, size_t n);
+ *   int psort_u64(uint64_t *base, size_t n);
+ *   int psort_f32(float *base, size_t n);     NaNs sort last
+ *   int psort_f64(double *base, size_t n);    NaNs sort last
+ *   int psort_kv(psort_kv_t *base, size_t n); 16-byte (key, index) records
+ *
+ * All variants are stable parallel merge sorts using OpenMP tasks, one
+ * ping-pong scratch buffer and co-rank split parallel merges. They may be
+ * called from serial code (a team is created) or from inside a parallel
+ * region (tasks run on the current team). They return 0 on success and -1
+ * if the scratch buffer cannot be allocated, leaving base untouched.
+ *
+ * Task granularity is chosen at runtime by psort_compute_cutoff() from the
+ * team size, n and the element size, and can be forced with the
+ * PSORT_THRESHOLD (leaf size in elements) and PSORT_MAX_DEPTH environment
+ * variables. Overrides must be plain decimal numbers; the threshold is
+ * clamped to [PSORT_INSERTION_THRESHOLD, INT_MAX] and the depth to
+ * PSORT_MAX_DEPTH_LIMIT, and anything else is ignored.
+ *
+ * More element types can be added the same way the built-in ones are:
+ * define PSORT_NAME, PSORT_TYPE and PSORT_LESS, then include
+ * psort_template.h.
+ *
+ * Argsort, for reordering several column arrays by one key column:
+ *
+ *   int psort_argsort_i32(const int32_t *keys, size_t n, uint32_t *perm);
+ *   int psort_argsort_u32(const uint32_t *keys, size_t n, uint32_t *perm);
+ *   int psort_argsort_f32(const float *keys, size_t n, uint32_t *perm);
+ *   void psort_gather(const uint32_t *perm, size_t n, int ncols,
+ *                     const void *const src[], void *const dst[],
+ *                     const size_t elem_size[]);
+ *
+ * psort_argsort_* fill perm so that keys[perm[0]], keys[perm[1]], ... is
+ * sorted, with equal keys in index order (stable); keys is not modified.
+ * They return -1 if n exceeds UINT32_MAX or memory runs out.
+ * psort_gather then sets dst[c][i] = src[c][perm[i]] for every column c.
+ *
+ * K-way merge of already sorted runs:
+ *
+ *   int psort_kway_merge_i32(const int32_t *const runs[], const int lens[],
+ *                            int k, int32_t *out);
+ *
+ * Merges k <= PSORT_KWAY_MAX_FANIN runs into out through a loser tree,
+ * stable across runs, with the output split between threads by
+ * multi-sequence selection. Returns -1 if k is out of range.
+ */
+
+#ifndef PSORT_H
+#define PSORT_H
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <omp.h>
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+// Aim for this many leaf tasks per thread so work stealing can balance load
+#define PSORT_TASKS_PER_THREAD 8
+// L2 cache size assumed when it cannot be queried
+#define PSORT_DEFAULT_L2_BYTES (256 * 1024)
+// Lower bound on the leaf size, whatever the cache size reports
+#define PSORT_MIN_THRESHOLD 4096
+// Ranges up to this size are insertion sorted
+#define PSORT_INSERTION_THRESHOLD 16
+// Deepest task tree PSORT_MAX_DEPTH may ask for (2^depth leaves must fit an int)
+#define PSORT_MAX_DEPTH_LIMIT 30
+
+#define PSORT_CAT_(a, b) a##b
+#define PSORT_CAT(a, b) PSORT_CAT_(a, b)
+
+typedef int (*psort_cmp_fn)(const void *a, const void *b);
+
+// Runtime task cutoff for the recursive sorts
+typedef struct {
+    size_t threshold;   // ranges smaller than this are sorted by one task
+    int max_depth;      // no tasks are created at or below this depth
+    int threads;        // team size the cutoff was computed for
+    int overridden;     // 1 if an environment variable forced a value
+} psort_cutoff_t;
+
+// Per-core L2 size in bytes
+static inline size_t psort_l2_bytes(void) {
+#if defined(__linux__) && defined(_SC_LEVEL2_CACHE_SIZE)
+    long l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (l2 > 0) return (size_t)l2;
+#endif
+    return PSORT_DEFAULT_L2_BYTES;
+}
+
+// Reads a decimal environment value; returns 0 if unset or not a number
+static inline int psort_env_number(const char *name, unsigned long long *value) {
+    const char *env = getenv(name);
+    char *end;
+    
+    if (env == NULL || env[0] < '0' || env[0] > '9') return 0;
+    *value = strtoull(env, &end, 10);
+    return *end == '\0';
+}
+
+// Choose the task cutoff for sorting n elements of elem_size bytes on a
+// team of the given size: about PSORT_TASKS_PER_THREAD leaf tasks per
+// thread, but no leaf smaller than what fills L2 together with its scratch
+// space. PSORT_THRESHOLD / PSORT_MAX_DEPTH override the computed values.
+static inline psort_cutoff_t psort_compute_cutoff(size_t n, size_t elem_size, int threads) {
+    psort_cutoff_t cut;
+    cut.threads = threads;
+    cut.overridden = 0;
+    
+    cut.threshold = psort_l2_bytes() / (2 * elem_size);
+    if (cut.threshold < PSORT_MIN_THRESHOLD) cut.threshold = PSORT_MIN_THRESHOLD;
+    
+    cut.max_depth = 0;
+    if (threads > 1) {
+        while ((1L << cut.max_depth) < (long)threads * PSORT_TASKS_PER_THREAD) cut.max_depth++;
+        while (cut.max_depth > 0 && (n >> cut.max_depth) < cut.threshold) cut.max_depth--;
+    }
+    
+    unsigned long long value;
+    if (psort_env_number("PSORT_THRESHOLD", &value)) {
+        if (value < PSORT_INSERTION_THRESHOLD) value = PSORT_INSERTION_THRESHOLD;
+        if (value > INT_MAX) value = INT_MAX;
+        cut.threshold = (size_t)value;
+        cut.overridden = 1;
+    }
+    if (psort_env_number("PSORT_MAX_DEPTH", &value)) {
+        cut.max_depth = (value > PSORT_MAX_DEPTH_LIMIT) ? PSORT_MAX_DEPTH_LIMIT : (int)value;
+        cut.overridden = 1;
+    }
+    
+    return cut;
+}
+
+// Key plus payload index, sorted by key; equal keys keep their input order
+typedef struct {
+    uint64_t key;
+    uint64_t index;
+} psort_kv_t;
+
+/* ---------------- Type-specialised variants ---------------- */
+
+#define PSORT_NAME psort_i32
+#define PSORT_TYPE int32_t
+#define PSORT_LESS(a, b) ((a) < (b))
+#include "psort_template.h"
+
+#define PSORT_NAME psort_u32
+#define PSORT_TYPE uint32_t
+#define PSORT_LESS(a, b) ((a) < (b))
+#include "psort_template.h"
+
+#define PSORT_NAME psort_u64
+#define PSORT_TYPE uint64_t
+#define PSORT_LESS(a, b) ((a) < (b))
+#include "psort_template.h"
+
+// Floating point: every NaN compares greater than every number
+#define PSORT_NAME psort_f32
+#define PSORT_TYPE float
+#define PSORT_LESS(a, b) ((a) < (b) || ((b) != (b) && (a) == (a)))
+#include "psort_template.h"
+
+#define PSORT_NAME psort_f64
+#define PSORT_TYPE double
+#define PSORT_LESS(a, b) ((a) < (b) || ((b) != (b) && (a) == (a)))
+#include "psort_template.h"
+
+#define PSORT_NAME psort_kv
+#define PSORT_TYPE psort_kv_t
+#define PSORT_LESS(a, b) ((a).key < (b).key)
+#include "psort_template.h"
+
+/* ---------------- K-way merge ---------------- */
+
+// Most runs merged at once by psort_kway_merge_i32
+#define PSORT_KWAY_MAX_FANIN 64
+
+
+// Loser tree over k sorted sources. tree[0] is the source holding the
+// smallest current key; tree[1..k) keep the loser of the match played at
+// each internal node, with the sources as virtual leaves k..2k-1. After the
+// winner's key changes, one replay walks a single leaf-to-root path, i.e.
+// log2(k) comparisons per output element. Each source's head key is stored
+// as key * 2^32 + source, so one 64-bit compare orders keys and breaks ties
+// towards the lower source (a stable merge), and an exhausted source holds
+// PSORT_LOSER_TREE_DONE, which loses to every key.
+#define PSORT_LOSER_TREE_DONE LLONG_MAX
+
+typedef struct {
+    int k;
+    int *tree;
+    long long *keys;   // packed head key of each source
+} psort_loser_tree_t;
+
+static inline long long psort_loser_tree_key(int32_t key, int source) {
+    return (long long)key * 4294967296LL + source;
+}
+
+static inline int psort_loser_tree_init(psort_loser_tree_t *lt, int k) {
+    lt->k = k;
+    lt->tree = (int*)malloc(k * sizeof(int));
+    lt->keys = (long long*)malloc(k * sizeof(long long));
+    if (lt->tree == NULL || lt->keys == NULL) {
+        free(lt->tree);
+        free(lt->keys);
+        return -1;
+    }
+    return 0;
+}
+
+static inline void psort_loser_tree_free(psort_loser_tree_t *lt) {
+    free(lt->tree);
+    free(lt->keys);
+}
+
+// Plays every match below node and returns the winner of that subtree
+static inline int psort_loser_tree_play(psort_loser_tree_t *lt, int node) {
+    if (node >= lt->k) return node - lt->k;
+    
+    int winner = psort_loser_tree_play(lt, 2 * node);
+    int loser = psort_loser_tree_play(lt, 2 * node + 1);
+    if (lt->keys[loser] < lt->keys[winner]) {
+        int t = winner;
+        winner = loser;
+        loser = t;
+    }
+    lt->tree[node] = loser;
+    return winner;
+}
+
+// Builds the tree once keys[] holds every source's first key
+static inline void psort_loser_tree_build(psort_loser_tree_t *lt) {
+    lt->tree[0] = psort_loser_tree_play(lt, 1);
+}
+
+// Restores the tree after the winner's key has changed
+static inline void psort_loser_tree_replay(psort_loser_tree_t *lt) {
+    int winner = lt->tree[0];
+    long long key = lt->keys[winner];
+    
+    for (int node = (winner + lt->k) >> 1; node > 0; node >>= 1) {
+        int other = lt->tree[node];
+        long long other_key = lt->keys[other];
+        // Branch-free select: the outcome of each match is unpredictable
+        int swap = -(other_key < key);
+        lt->tree[node] = other ^ ((other ^ winner) & swap);
+        winner ^= (winner ^ other) & swap;
+        key = (other_key < key) ? other_key : key;
+    }
+    lt->tree[0] = winner;
+}
+
+// Multi-sequence selection: splits k sorted runs at global output rank r.
+// Sets pos[s] so that the first pos[s] elements of every run, r in total,
+// are exactly the first r outputs of a stable k-way merge: the splitting
+// key v is found by binary search over the key range, everything below v
+// goes left, and copies of v are handed out to the lowest runs first.
+static inline void psort_multiway_select(const int32_t *const runs[], const int lens[], int k, long long r,
+                                         int pos[]) {
+    if (r <= 0) {
+        memset(pos, 0, k * sizeof(int));
+        return;
+    }
+    
+    // Smallest v with at least r elements <= v
+    long long lo = INT_MIN, hi = INT_MAX;
+    while (lo < hi) {
+        long long v = lo + (hi - lo) / 2;
+        long long count = 0;
+        for (int s = 0; s < k; s++) {
+            int a = 0, b = lens[s];
+            while (a < b) {
+                int m = a + (b - a) / 2;
+                if (runs[s][m] <= v) a = m + 1; else b = m;
+            }
+            count += a;
+        }
+        if (count >= r) hi = v; else lo = v + 1;
+    }
+    
+    // Everything below v, then as many copies of v as are still needed
+    long long need = r;
+    int upper[PSORT_KWAY_MAX_FANIN];
+    for (int s = 0; s < k; s++) {
+        int a = 0, b = lens[s];
+        while (a < b) {
+            int m = a + (b - a) / 2;
+            if (runs[s][m] < lo) a = m + 1; else b = m;
+        }
+        pos[s] = a;
+        need -= a;
+        
+        b = lens[s];
+        while (a < b) {
+            int m = a + (b - a) / 2;
+            if (runs[s][m] <= lo) a = m + 1; else b = m;
+        }
+        upper[s] = a;
+    }
+    for (int s = 0; s < k && need > 0; s++) {
+        int take = upper[s] - pos[s];
+        if (take > need) take = (int)need;
+        pos[s] += take;
+        need -= take;
+    }
+}
+
+// Sequential k-way merge of runs[s][begin[s]..end[s]) into out through a
+// loser tree. Ties go to the lower run, so the merge is stable.
+static inline void psort_kway_merge_seq(const int32_t *const runs[], const int begin[], const int end[], int k,
+                                        int32_t *out) {
+    int tree[PSORT_KWAY_MAX_FANIN], cur[PSORT_KWAY_MAX_FANIN];
+    long long keys[PSORT_KWAY_MAX_FANIN];
+    psort_loser_tree_t lt = {k, tree, keys};
+    long long total = 0;
+    
+    for (int s = 0; s < k; s++) {
+        cur[s] = begin[s];
+        keys[s] = (cur[s] < end[s]) ? psort_loser_tree_key(runs[s][cur[s]], s) : PSORT_LOSER_TREE_DONE;
+        total += end[s] - begin[s];
+    }
+    psort_loser_tree_build(&lt);
+    
+    for (long long i = 0; i < total; i++) {
+        int s = tree[0];
+        out[i] = runs[s][cur[s]];
+        keys[s] = (++cur[s] < end[s]) ? psort_loser_tree_key(runs[s][cur[s]], s) : PSORT_LOSER_TREE_DONE;
+        psort_loser_tree_replay(&lt);
+    }
+}
+
+// Parallel k-way merge (k <= PSORT_KWAY_MAX_FANIN) of sorted runs into out. The
+// output is cut into equal slices, psort_multiway_select finds where each slice
+// starts in every run, and every slice is merged by its own task.
+static inline void psort_kway_merge_parallel(const int32_t *const runs[], const int lens[], int k, int32_t *out,
+                                             const psort_cutoff_t *cut) {
+    long long total = 0;
+    for (int s = 0; s < k; s++) total += lens[s];
+    
+    int parts = cut->threads;
+    if (parts > total / (long long)cut->threshold) {
+        parts = (int)(total / (long long)cut->threshold);
+    }
+    if (parts < 1) parts = 1;
+    
+    for (int p = 0; p < parts; p++) {
+        #pragma omp task firstprivate(p) untied if(parts > 1)
+        {
+            long long k0 = total * p / parts;
+            long long k1 = total * (p + 1) / parts;
+            int begin[PSORT_KWAY_MAX_FANIN], end[PSORT_KWAY_MAX_FANIN];
+            
+            psort_multiway_select(runs, lens, k, k0, begin);
+            psort_multiway_select(runs, lens, k, k1, end);
+            psort_kway_merge_seq(runs, begin, end, k, out + k0);
+        }
+    }
+    
+    #pragma omp taskwait
+}
+
+// Merges k sorted runs (k <= PSORT_KWAY_MAX_FANIN) into out, which must have room
+// for all of them and not overlap any run. The merge is stable across runs.
+// Can be called from serial code (a team is created) or inside a parallel
+// region. Returns 0 on success, -1 if k is out of range.
+static inline int psort_kway_merge_i32(const int32_t *const runs[], const int lens[], int k, int32_t *out) {
+    if (k < 1 || k > PSORT_KWAY_MAX_FANIN) return -1;
+    
+    long long total = 0;
+    for (int s = 0; s < k; s++) total += lens[s];
+    
+    if (omp_in_parallel()) {
+        psort_cutoff_t cut = psort_compute_cutoff((size_t)total, sizeof(int32_t), omp_get_num_threads());
+        psort_kway_merge_parallel(runs, lens, k, out, &cut);
+    } else {
+        #pragma omp parallel
+        {
+            #pragma omp single
+            {
+                psort_cutoff_t cut = psort_compute_cutoff((size_t)total, sizeof(int32_t), omp_get_num_threads());
+                psort_kway_merge_parallel(runs, lens, k, out, &cut);
+            }
+        }
+    }
+    return 0;
+}
+
+/* ---------------- Argsort ---------------- */
+
+// Output positions gathered per block: the block's slice of perm stays in
+// L1 while every column is gathered through it
+#define PSORT_GATHER_BLOCK 4096
+
+// Each (key, index) pair is packed into one uint64_t, key bits on top, so
+// psort_u64 sorts the pairs with plain integer compares; the index in the
+// low half breaks ties, which makes the order stable. The key bits must be
+// mapped so that unsigned order matches key order.
+static inline uint64_t *psort_argsort_alloc(size_t n) {
+    if (n > UINT32_MAX) return NULL;
+    return (uint64_t *)malloc((n > 0 ? n : 1) * sizeof(uint64_t));
+}
+
+// Sorts the packed pairs, extracts the indices into perm and frees packed
+static inline int psort_argsort_finish(uint64_t *packed, size_t n, uint32_t *perm) {
+    int rc = psort_u64(packed, n);
+    
+    if (rc == 0) {
+        #pragma omp parallel for schedule(static)
+        for (long long i = 0; i < (long long)n; i++) {
+            perm[i] = (uint32_t)packed[i];
+        }
+    }
+    free(packed);
+    return rc;
+}
+
+// Signed keys: flipping the sign bit gives unsigned order
+static inline int psort_argsort_i32(const int32_t *keys, size_t n, uint32_t *perm) {
+    uint64_t *packed = psort_argsort_alloc(n);
+    if (packed == NULL) return -1;
+    
+    #pragma omp parallel for schedule(static)
+    for (long long i = 0; i < (long long)n; i++) {
+        packed[i] = ((uint64_t)((uint32_t)keys[i] ^ 0x80000000u) << 32) | (uint64_t)i;
+    }
+    return psort_argsort_finish(packed, n, perm);
+}
+
+static inline int psort_argsort_u32(const uint32_t *keys, size_t n, uint32_t *perm) {
+    uint64_t *packed = psort_argsort_alloc(n);
+    if (packed == NULL) return -1;
+    
+    #pragma omp parallel for schedule(static)
+    for (long long i = 0; i < (long long)n; i++) {
+        packed[i] = ((uint64_t)keys[i] << 32) | (uint64_t)i;
+    }
+    return psort_argsort_finish(packed, n, perm);
+}
+
+// IEEE order as unsigned bits: negative values are inverted, positive ones
+// get the sign bit set (so -0.0 sorts before +0.0); every NaN maps to
+// the top so NaNs sort last
+static inline uint32_t psort_f32_bits(float f) {
+    uint32_t u;
+    memcpy(&u, &f, sizeof(u));
+    if (f != f) return UINT32_MAX;
+    return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+}
+
+static inline int psort_argsort_f32(const float *keys, size_t n, uint32_t *perm) {
+    uint64_t *packed = psort_argsort_alloc(n);
+    if (packed == NULL) return -1;
+    
+    #pragma omp parallel for schedule(static)
+    for (long long i = 0; i < (long long)n; i++) {
+        packed[i] = ((uint64_t)psort_f32_bits(keys[i]) << 32) | (uint64_t)i;
+    }
+    return psort_argsort_finish(packed, n, perm);
+}
+
+// Gathers every column through perm: dst[c][i] = src[c][perm[i]]. Output
+// blocks are spread over the threads; 4- and 8-byte columns get direct
+// loads and stores, other sizes are copied with memcpy.
+static inline void psort_gather(const uint32_t *perm, size_t n, int ncols,
+                                const void *const src[], void *const dst[],
+                                const size_t elem_size[]) {
+    long long nblocks = (long long)((n + PSORT_GATHER_BLOCK - 1) / PSORT_GATHER_BLOCK);
+    
+    #pragma omp parallel for schedule(static)
+    for (long long blk = 0; blk < nblocks; blk++) {
+        size_t lo = (size_t)blk * PSORT_GATHER_BLOCK;
+        size_t hi = (lo + PSORT_GATHER_BLOCK < n) ? lo + PSORT_GATHER_BLOCK : n;
+        
+        for (int c = 0; c < ncols; c++) {
+            size_t size = elem_size[c];
+            if (size == 4) {
+                const uint32_t *s = (const uint32_t *)src[c];
+                uint32_t *d = (uint32_t *)dst[c];
+                for (size_t i = lo; i < hi; i++) d[i] = s[perm[i]];
+            } else if (size == 8) {
+                const uint64_t *s = (const uint64_t *)src[c];
+                uint64_t *d = (uint64_t *)dst[c];
+                for (size_t i = lo; i < hi; i++) d[i] = s[perm[i]];
+            } else {
+                const char *s = (const char *)src[c];
+                char *d = (char *)dst[c];
+                for (size_t i = lo; i < hi; i++) memcpy(d + i * size, s + (size_t)perm[i] * size, size);
+            }
+        }
+    }
+}
+
+/* ---------------- Generic variant ---------------- */
+
+// Swap two elements of the given size
+static inline void psort_generic_swap(char *x, char *y, size_t size) {
+    char tmp[64];
+    while (size > 0) {
+        size_t chunk = (size < sizeof(tmp)) ? size : sizeof(tmp);
+        memcpy(tmp, x, chunk);
+        memcpy(x, y, chunk);
+        memcpy(y, tmp, chunk);
+        x += chunk;
+        y += chunk;
+        size -= chunk;
+    }
+}
+
+// Stable insertion sort of n elements of the given size
+static inline void psort_generic_insertion(char *a, size_t n, size_t size, psort_cmp_fn cmp) {
+    for (size_t i = 1; i < n; i++) {
+        for (size_t j = i; j > 0 && cmp(a + (j - 1) * size, a + j * size) > 0; j--) {
+            psort_generic_swap(a + (j - 1) * size, a + j * size, size);
+        }
+    }
+}
+
+// Stable merge of sorted a[0..na) and b[0..nb) into out
+static inline void psort_generic_merge(const char *a, size_t na, const char *b, size_t nb,
+                                       char *out, size_t size, psort_cmp_fn cmp) {
+    const char *a_end = a + na * size;
+    const char *b_end = b + nb * size;
+    
+    while (a < a_end && b < b_end) {
+        if (cmp(b, a) < 0) {
+            memcpy(out, b, size);
+            b += size;
+        } else {
+            memcpy(out, a, size);
+            a += size;
+        }
+        out += size;
+    }
+    
+    if (a < a_end) memcpy(out, a, a_end - a);
+    if (b < b_end) memcpy(out, b, b_end - b);
+}
+
+// Co-rank search: how many of the first k merged outputs come from a
+static inline size_t psort_generic_co_rank(size_t k, const char *a, size_t na,
+                                           const char *b, size_t nb,
+                                           size_t size, psort_cmp_fn cmp) {
+    size_t lo = (k > nb) ? k - nb : 0;
+    size_t hi = (k < na) ? k : na;
+    
+    while (lo < hi) {
+        size_t i = lo + (hi - lo) / 2;
+        if (cmp(b + (k - i - 1) * size, a + i * size) >= 0) {
+            lo = i + 1;
+        } else {
+            hi = i;
+        }
+    }
+    return lo;
+}
+
+// Parallel merge: equal output slices, one task each
+static inline void psort_generic_merge_parallel(const char *a, size_t na, const char *b, size_t nb,
+                                                char *out, size_t size, psort_cmp_fn cmp,
+                                                const psort_cutoff_t *cut) {
+    size_t total = na + nb;
+    size_t parts = (size_t)cut->threads;
+    
+    if (parts > total / cut->threshold) {
+        parts = total / cut->threshold;
+    }
+    if (parts < 2) {
+        psort_generic_merge(a, na, b, nb, out, size, cmp);
+        return;
+    }
+    
+    for (size_t p = 0; p < parts; p++) {
+        #pragma omp task firstprivate(p) untied
+        {
+            size_t k0 = total * p / parts;
+            size_t k1 = total * (p + 1) / parts;
+            size_t i0 = psort_generic_co_rank(k0, a, na, b, nb, size, cmp);
+            size_t i1 = psort_generic_co_rank(k1, a, na, b, nb, size, cmp);
+            
+            psort_generic_merge(a + i0 * size, i1 - i0,
+                                b + (k0 - i0) * size, (k1 - i1) - (k0 - i0),
+                                out + k0 * size, size, cmp);
+        }
+    }
+    
+    #pragma omp taskwait
+}
+
+// Sorts arr[0..n) using aux[0..n) as scratch; result lands in aux if to_aux
+static inline void psort_generic_sort_buf(char *arr, char *aux, size_t n, size_t size,
+                                          psort_cmp_fn cmp, const psort_cutoff_t *cut,
+                                          int depth, int to_aux) {
+    if (n <= PSORT_INSERTION_THRESHOLD) {
+        if (to_aux) memcpy(aux, arr, n * size);
+        psort_generic_insertion(to_aux ? aux : arr, n, size, cmp);
+        return;
+    }
+    
+    size_t half = n / 2;
+    const char *src = to_aux ? arr : aux;
+    char *dst = to_aux ? aux : arr;
+    
+    if (n >= cut->threshold && depth < cut->max_depth) {
+        #pragma omp task untied
+        psort_generic_sort_buf(arr, aux, half, size, cmp, cut, depth + 1, !to_aux);
+        
+        #pragma omp task untied
+        psort_generic_sort_buf(arr + half * size, aux + half * size, n - half, size, cmp, cut, depth + 1, !to_aux);
+        
+        #pragma omp taskwait
+        psort_generic_merge_parallel(src, half, src + half * size, n - half, dst, size, cmp, cut);
+    } else {
+        psort_generic_sort_buf(arr, aux, half, size, cmp, cut, cut->max_depth, !to_aux);
+        psort_generic_sort_buf(arr + half * size, aux + half * size, n - half, size, cmp, cut, cut->max_depth, !to_aux);
+        psort_generic_merge(src, half, src + half * size, n - half, dst, size, cmp);
+    }
+}
+
+// Generic stable parallel sort with a qsort()-style comparison function
+static inline int psort(void *base, size_t n, size_t elem_size, psort_cmp_fn cmp) {
+    if (n < 2 || elem_size == 0) return 0;
+    
+    char *aux = (char *)malloc(n * elem_size);
+    if (aux == NULL) return -1;
+    
+    if (omp_in_parallel()) {
+        psort_cutoff_t cut = psort_compute_cutoff(n, elem_size, omp_get_num_threads());
+        psort_generic_sort_buf((char *)base, aux, n, elem_size, cmp, &cut, 0, 0);
+    } else {
+        #pragma omp parallel
+        {
+            #pragma omp single
+            {
+                psort_cutoff_t cut = psort_compute_cutoff(n, elem_size, omp_get_num_threads());
+                psort_generic_sort_buf((char *)base, aux, n, elem_size, cmp, &cut, 0, 0);
+            }
+        }
+    }
+    
+    free(aux);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,151 @@
+/**
+ * psort_template.h - Type-specialised parallel merge sort
+ *
+ * Included by psort.h once per element type (no include guard on purpose).
+ * Before including, define:
+ *
+ *   PSORT_NAME        name of the generated sort function, e.g. psort_u32
+ *   PSORT_TYPE        element type
+ *   PSORT_LESS(a, b)  strict weak ordering on two PSORT_TYPE values
+ *
+ * Generates int PSORT_NAME(PSORT_TYPE *base, size_t n) plus its helpers,
+ * all prefixed with PSORT_NAME. The three macros are undefined at the end.
+ */
+
+#if !defined(PSORT_NAME) || !defined(PSORT_TYPE) || !defined(PSORT_LESS)
+#error "Define PSORT_NAME, PSORT_TYPE and PSORT_LESS before including psort_template.h"
+#endif
+
+#define PSORT_FN(suffix) PSORT_CAT(PSORT_NAME, suffix)
+
+// Stable insertion sort for the leaves
+static inline void PSORT_FN(_insertion)(PSORT_TYPE *a, size_t n) {
+    for (size_t i = 1; i < n; i++) {
+        PSORT_TYPE key = a[i];
+        size_t j = i;
+        while (j > 0 && PSORT_LESS(key, a[j - 1])) {
+            a[j] = a[j - 1];
+            j--;
+        }
+        a[j] = key;
+    }
+}
+
+// Stable merge of sorted a[0..na) and b[0..nb) into out
+static inline void PSORT_FN(_merge)(const PSORT_TYPE *a, size_t na,
+                                    const PSORT_TYPE *b, size_t nb, PSORT_TYPE *out) {
+    size_t i = 0, j = 0, k = 0;
+    
+    while (i < na && j < nb) {
+        out[k++] = PSORT_LESS(b[j], a[i]) ? b[j++] : a[i++];
+    }
+    
+    if (i < na) memcpy(&out[k], &a[i], (na - i) * sizeof(PSORT_TYPE));
+    if (j < nb) memcpy(&out[k], &b[j], (nb - j) * sizeof(PSORT_TYPE));
+}
+
+// Co-rank search: how many of the first k merged outputs come from a
+static inline size_t PSORT_FN(_co_rank)(size_t k, const PSORT_TYPE *a, size_t na,
+                                        const PSORT_TYPE *b, size_t nb) {
+    size_t lo = (k > nb) ? k - nb : 0;
+    size_t hi = (k < na) ? k : na;
+    
+    while (lo < hi) {
+        size_t i = lo + (hi - lo) / 2;
+        if (!PSORT_LESS(b[k - i - 1], a[i])) {
+            lo = i + 1;
+        } else {
+            hi = i;
+        }
+    }
+    return lo;
+}
+
+// Parallel merge: equal output slices, one task each
+static inline void PSORT_FN(_merge_parallel)(const PSORT_TYPE *a, size_t na,
+                                             const PSORT_TYPE *b, size_t nb, PSORT_TYPE *out,
+                                             const psort_cutoff_t *cut) {
+    size_t total = na + nb;
+    size_t parts = (size_t)cut->threads;
+    
+    if (parts > total / cut->threshold) {
+        parts = total / cut->threshold;
+    }
+    if (parts < 2) {
+        PSORT_FN(_merge)(a, na, b, nb, out);
+        return;
+    }
+    
+    for (size_t p = 0; p < parts; p++) {
+        #pragma omp task firstprivate(p) untied
+        {
+            size_t k0 = total * p / parts;
+            size_t k1 = total * (p + 1) / parts;
+            size_t i0 = PSORT_FN(_co_rank)(k0, a, na, b, nb);
+            size_t i1 = PSORT_FN(_co_rank)(k1, a, na, b, nb);
+            
+            PSORT_FN(_merge)(a + i0, i1 - i0, b + (k0 - i0), (k1 - i1) - (k0 - i0), out + k0);
+        }
+    }
+    
+    #pragma omp taskwait
+}
+
+// Sorts arr[0..n) using aux[0..n) as scratch; result lands in aux if to_aux
+static inline void PSORT_FN(_sort_buf)(PSORT_TYPE *arr, PSORT_TYPE *aux, size_t n,
+                                       const psort_cutoff_t *cut, int depth, int to_aux) {
+    if (n <= PSORT_INSERTION_THRESHOLD) {
+        if (to_aux) memcpy(aux, arr, n * sizeof(PSORT_TYPE));
+        PSORT_FN(_insertion)(to_aux ? aux : arr, n);
+        return;
+    }
+    
+    size_t half = n / 2;
+    const PSORT_TYPE *src = to_aux ? arr : aux;
+    PSORT_TYPE *dst = to_aux ? aux : arr;
+    
+    if (n >= cut->threshold && depth < cut->max_depth) {
+        #pragma omp task untied
+        PSORT_FN(_sort_buf)(arr, aux, half, cut, depth + 1, !to_aux);
+        
+        #pragma omp task untied
+        PSORT_FN(_sort_buf)(arr + half, aux + half, n - half, cut, depth + 1, !to_aux);
+        
+        #pragma omp taskwait
+        PSORT_FN(_merge_parallel)(src, half, src + half, n - half, dst, cut);
+    } else {
+        PSORT_FN(_sort_buf)(arr, aux, half, cut, cut->max_depth, !to_aux);
+        PSORT_FN(_sort_buf)(arr + half, aux + half, n - half, cut, cut->max_depth, !to_aux);
+        PSORT_FN(_merge)(src, half, src + half, n - half, dst);
+    }
+}
+
+// Stable parallel sort of base[0..n)
+static inline int PSORT_NAME(PSORT_TYPE *base, size_t n) {
+    if (n < 2) return 0;
+    
+    PSORT_TYPE *aux = (PSORT_TYPE *)malloc(n * sizeof(PSORT_TYPE));
+    if (aux == NULL) return -1;
+    
+    if (omp_in_parallel()) {
+        psort_cutoff_t cut = psort_compute_cutoff(n, sizeof(PSORT_TYPE), omp_get_num_threads());
+        PSORT_FN(_sort_buf)(base, aux, n, &cut, 0, 0);
+    } else {
+        #pragma omp parallel
+        {
+            #pragma omp single
+            {
+                psort_cutoff_t cut = psort_compute_cutoff(n, sizeof(PSORT_TYPE), omp_get_num_threads());
+                PSORT_FN(_sort_buf)(base, aux, n, &cut, 0, 0);
+            }
+        }
+    }
+    
+    free(aux);
+    return 0;
+}
+
+#undef PSORT_FN
+#undef PSORT_NAME
+#undef PSORT_TYPE
+#undef PSORT_LESS
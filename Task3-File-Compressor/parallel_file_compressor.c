@@ -2,44 +2,506 @@
  * Parallel File Compressor - Task Pipeline with OpenMP
  * 
  * This program demonstrates a three-stage pipeline using OpenMP tasks:
- * 1. Read file chunks
- * 2. Compress chunks using Run-Length Encoding (RLE)
- * 3. Write compressed chunks to output file
+ * 1. Read file chunks (or slice them out of a memory-mapped input)
+ * 2. Compress chunks with the selected codec (RLE, LZ77, Huffman, LZ77+Huffman)
+ * 3. Write compressed chunks to output file (ordered writer, vectored I/O)
  * 
  * Uses OpenMP task dependencies to create a producer-consumer pipeline.
+ * Output is a binary container with a trailing chunk index (see below);
+ * --decompress restores it by decoding all chunks in parallel.
  */
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <omp.h>
 
-#define CHUNK_SIZE 1024  // Size of each chunk to process
-#define MAX_CHUNKS 100   // Maximum number of chunks to process
+// SIMD run scanners are compiled with a target attribute and picked at
+// runtime, so the binary still runs on CPUs without AVX2
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_SIMD_SCAN 1
+#endif
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#define DEFAULT_CHUNK_KB 256      // Default chunk size (--chunk-size)
+#define MIN_CHUNK_KB 4
+#define MAX_CHUNK_KB (64 * 1024)  // Keeps every chunk field within 32 bits
+#define PIPELINE_SLOTS 8          // Chunks in flight at once (ring of slots)
+#define RLE_BOUND(n) ((n) + ((n) + 127) / 128 + 1)  // Worst-case compress_rle output size
+#define RLE_TEXT_BOUND(n) (3 * (n) + 16)            // Worst-case compress_rle_text output size
+#define CACHE_LINE 64             // Alignment of pool and scratch buffers
 
 // Structure to hold chunk data
 typedef struct {
-    char *data;          // Original data
-    char *compressed;    // Compressed data
-    int original_size;   // Size of original data
-    int compressed_size; // Size of compressed data
-    int chunk_id;        // Chunk identifier
-    int valid;           // Whether this chunk contains valid data
+    char *data;             // Original data
+    char *compressed;       // Compressed data
+    size_t original_size;   // Size of original data
+    size_t compressed_size; // Size of compressed data
+    uint64_t chunk_id;      // Chunk identifier
+    int valid;              // Whether this chunk contains valid data
+    int failed;             // Set when a stage could not process the chunk
+    int ready;              // Compressed and waiting in the reorder buffer
+    uint64_t raw_offset;    // Offset of the data in the input file
+    uint32_t checksum;      // CRC-32 of the original data
+    uint16_t codec;         // Codec id of the compressed data
+    char *in_buffer;        // Slot's pool buffer for input that is read, not mapped
+    char *out_buffer;       // Slot's pool buffer for compressed data
 } Chunk;
 
+static int pipeline_verbose = 1;  // Per-chunk [READ]/[COMPRESS]/[WRITE] lines (--quiet clears)
+
+// How chunks are obtained from the input
+typedef enum {
+    INPUT_STREAM,  // Sequential fread (pipes, stdin); reads are serialized
+    INPUT_PREAD,   // Positional reads; chunks are read independently
+    INPUT_MMAP     // Chunks are slices of the mapped file; no copy at all
+} InputMode;
+
+typedef struct {
+    InputMode mode;
+    FILE *file;     // INPUT_STREAM
+    int fd;         // INPUT_PREAD and INPUT_MMAP
+    char *map;      // INPUT_MMAP
+    uint64_t size;  // File size (INPUT_PREAD and INPUT_MMAP)
+} InputSource;
+
+static const char *input_mode_name[] = {"stream", "pread", "mmap"};
+
+/*
+ * Container format (all integers little-endian)
+ *
+ *   file header   16 B: "PFCZ", u16 version, u16 flags, u32 chunk size, u32 reserved
+ *   per chunk     32 B: u32 chunk id, u16 codec, u16 flags, u64 raw offset,
+ *                       u32 raw size, u32 compressed size, u32 CRC-32 of raw data,
+ *                       u32 reserved; then the compressed payload
+ *   chunk index   32 B per chunk: u64 header offset, u64 raw offset, u32 raw size,
+ *                       u32 compressed size, u32 CRC-32, u16 codec, u16 flags
+ *   footer        32 B: u64 index offset, u64 chunk count, u64 raw total,
+ *                       u32 CRC-32 of the index, "PFCX"
+ *
+ * The footer sits at a fixed distance from the end of the file, so a reader
+ * finds the index with one seek and any chunk with one more.
+ */
+#define CONTAINER_MAGIC "PFCZ"
+#define CONTAINER_INDEX_MAGIC "PFCX"
+#define CONTAINER_VERSION 1
+#define CONTAINER_HEADER_SIZE 16
+#define CHUNK_HEADER_SIZE 32
+#define INDEX_ENTRY_SIZE 32
+#define FOOTER_SIZE 32
+
+#define CODEC_STORED 0     // Raw bytes, for chunks that do not compress
+#define CODEC_RLE_TEXT 1  // Original text RLE (compress_rle_text); still decoded
+#define CODEC_RLE 2       // PackBits-style binary RLE (compress_rle)
+#define CODEC_LZ 3        // LZ77 with a hash-chain match finder
+#define CODEC_HUFFMAN 4   // Canonical Huffman over bytes
+#define CODEC_LZ_HUFFMAN 5  // LZ77, then Huffman over the LZ stream
+
+#ifdef _WIN32
+#define file_seek _fseeki64
+#define file_tell _ftelli64
+#else
+#define file_seek fseeko
+#define file_tell ftello
+#endif
+
+// One chunk index entry (in memory)
+typedef struct {
+    uint64_t file_offset;     // Offset of the chunk header in the container
+    uint64_t raw_offset;      // Offset of the data in the original file
+    uint32_t raw_size;
+    uint32_t compressed_size;
+    uint32_t checksum;        // CRC-32 of the original data
+    uint16_t codec;
+    uint16_t flags;
+} ChunkIndexEntry;
+
+// One piece of a vectored write
+#ifdef _WIN32
+typedef struct {
+    void *iov_base;
+    size_t iov_len;
+} IoSlice;
+#else
+typedef struct iovec IoSlice;
+#endif
+
+// Appends chunks to a container and collects the index
+typedef struct {
+    FILE *file;
+    uint64_t offset;          // Bytes written so far
+    uint64_t raw_total;
+    ChunkIndexEntry *entries;
+    uint64_t count;
+    uint64_t capacity;
+} ContainerWriter;
+
+// Index of an existing container
+typedef struct {
+    uint32_t chunk_size;
+    uint64_t raw_total;
+    uint64_t index_offset;  // End of the chunk area
+    uint64_t count;
+    ChunkIndexEntry *entries;
+} ContainerIndex;
+
+// Little-endian field helpers
+static void put_u16(unsigned char *p, uint16_t v) {
+    p[0] = (unsigned char)v;
+    p[1] = (unsigned char)(v >> 8);
+}
+
+static void put_u32(unsigned char *p, uint32_t v) {
+    put_u16(p, (uint16_t)v);
+    put_u16(p + 2, (uint16_t)(v >> 16));
+}
+
+static void put_u64(unsigned char *p, uint64_t v) {
+    put_u32(p, (uint32_t)v);
+    put_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint16_t get_u16(const unsigned char *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    return (uint32_t)get_u16(p) | ((uint32_t)get_u16(p + 2) << 16);
+}
+
+static uint64_t get_u64(const unsigned char *p) {
+    return (uint64_t)get_u32(p) | ((uint64_t)get_u32(p + 4) << 32);
+}
+
+// crc32_table[k][b]: CRC of byte b followed by k zero bytes (slicing-by-8)
+static uint32_t crc32_table[8][256];
+
+/**
+ * Build the CRC-32 (IEEE, reflected) lookup tables
+ * Must run before any parallel use of crc32_update
+ */
+void crc32_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crc32_table[0][i] = c;
+    }
+    for (int k = 1; k < 8; k++) {
+        for (int i = 0; i < 256; i++) {
+            uint32_t c = crc32_table[k - 1][i];
+            crc32_table[k][i] = (c >> 8) ^ crc32_table[0][c & 0xFF];
+        }
+    }
+}
+
+/**
+ * CRC-32 of a buffer, continuing from a previous value (start with 0)
+ * Eight bytes per step through eight independent table lookups
+ */
+uint32_t crc32_update(uint32_t crc, const void *data, size_t size) {
+    const unsigned char *p = (const unsigned char *)data;
+    crc = ~crc;
+    for (; size >= 8; p += 8, size -= 8) {
+        uint32_t lo = crc ^ get_u32(p);
+        uint32_t hi = get_u32(p + 4);
+        crc = crc32_table[7][lo & 0xFF] ^ crc32_table[6][(lo >> 8) & 0xFF] ^
+              crc32_table[5][(lo >> 16) & 0xFF] ^ crc32_table[4][lo >> 24] ^
+              crc32_table[3][hi & 0xFF] ^ crc32_table[2][(hi >> 8) & 0xFF] ^
+              crc32_table[1][(hi >> 16) & 0xFF] ^ crc32_table[0][hi >> 24];
+    }
+    for (; size > 0; p++, size--) {
+        crc = crc32_table[0][(crc ^ *p) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+
+/**
+ * Write slices back to back at the end of the container
+ * POSIX uses writev on the descriptor (stdio is never used for output);
+ * Windows falls back to fwrite through a large stdio buffer.
+ */
+static int container_write(ContainerWriter *w, IoSlice *slices, int count) {
+#ifndef _WIN32
+    int fd = fileno(w->file);
+    while (count > 0) {
+        ssize_t n = writev(fd, slices, count);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        // Skip what was written; resume a partially written slice
+        while (count > 0 && (size_t)n >= slices->iov_len) {
+            n -= (ssize_t)slices->iov_len;
+            slices++;
+            count--;
+        }
+        if (count > 0) {
+            slices->iov_base = (char *)slices->iov_base + n;
+            slices->iov_len -= (size_t)n;
+        }
+    }
+#else
+    for (int i = 0; i < count; i++) {
+        if (fwrite(slices[i].iov_base, 1, slices[i].iov_len, w->file) != slices[i].iov_len) return -1;
+    }
+#endif
+    return 0;
+}
+
+/**
+ * Start a container: write the file header
+ * Returns 0 on success, -1 on write failure
+ */
+int container_begin(ContainerWriter *w, FILE *file, uint32_t chunk_size) {
+    unsigned char header[CONTAINER_HEADER_SIZE] = {0};
+    
+    memset(w, 0, sizeof(*w));
+    w->file = file;
+#ifdef _WIN32
+    setvbuf(file, NULL, _IOFBF, 1 << 20);
+#endif
+    
+    memcpy(header, CONTAINER_MAGIC, 4);
+    put_u16(header + 4, CONTAINER_VERSION);
+    put_u32(header + 8, chunk_size);
+    
+    IoSlice slice = {header, sizeof(header)};
+    if (container_write(w, &slice, 1) != 0) return -1;
+    w->offset = sizeof(header);
+    return 0;
+}
+
+/**
+ * Record the next chunk in the index and encode its header
+ * The caller writes header + payload right after the previous chunk;
+ * chunks must be added in chunk_id order.
+ */
+int container_add_chunk(ContainerWriter *w, const Chunk *chunk, unsigned char *header) {
+    if (w->count == w->capacity) {
+        uint64_t capacity = w->capacity ? w->capacity * 2 : 64;
+        ChunkIndexEntry *grown = (ChunkIndexEntry *)realloc(w->entries, capacity * sizeof(ChunkIndexEntry));
+        if (!grown) return -1;
+        w->entries = grown;
+        w->capacity = capacity;
+    }
+    
+    ChunkIndexEntry *e = &w->entries[w->count];
+    e->file_offset = w->offset;
+    e->raw_offset = chunk->raw_offset;
+    e->raw_size = (uint32_t)chunk->original_size;
+    e->compressed_size = (uint32_t)chunk->compressed_size;
+    e->checksum = chunk->checksum;
+    e->codec = chunk->codec;
+    e->flags = 0;
+    
+    memset(header, 0, CHUNK_HEADER_SIZE);
+    put_u32(header, (uint32_t)chunk->chunk_id);
+    put_u16(header + 4, e->codec);
+    put_u16(header + 6, e->flags);
+    put_u64(header + 8, e->raw_offset);
+    put_u32(header + 16, e->raw_size);
+    put_u32(header + 20, e->compressed_size);
+    put_u32(header + 24, e->checksum);
+    
+    w->offset += CHUNK_HEADER_SIZE + e->compressed_size;
+    w->raw_total += e->raw_size;
+    w->count++;
+    return 0;
+}
+
+/**
+ * Drop an unfinished container: frees the index without writing it, so
+ * the output has no footer and is never accepted as a container
+ */
+void container_abort(ContainerWriter *w) {
+    free(w->entries);
+    w->entries = NULL;
+}
+
+/**
+ * Write the chunk index and footer, then release the writer's index
+ */
+int container_finish(ContainerWriter *w) {
+    size_t index_bytes = (size_t)w->count * INDEX_ENTRY_SIZE;
+    unsigned char *index = (unsigned char *)malloc(index_bytes ? index_bytes : 1);
+    unsigned char footer[FOOTER_SIZE];
+    int status = 0;
+    
+    if (!index) {
+        free(w->entries);
+        w->entries = NULL;
+        return -1;
+    }
+    
+    for (uint64_t i = 0; i < w->count; i++) {
+        const ChunkIndexEntry *e = &w->entries[i];
+        unsigned char *p = index + i * INDEX_ENTRY_SIZE;
+        put_u64(p, e->file_offset);
+        put_u64(p + 8, e->raw_offset);
+        put_u32(p + 16, e->raw_size);
+        put_u32(p + 20, e->compressed_size);
+        put_u32(p + 24, e->checksum);
+        put_u16(p + 28, e->codec);
+        put_u16(p + 30, e->flags);
+    }
+    
+    put_u64(footer, w->offset);
+    put_u64(footer + 8, w->count);
+    put_u64(footer + 16, w->raw_total);
+    put_u32(footer + 24, crc32_update(0, index, index_bytes));
+    memcpy(footer + 28, CONTAINER_INDEX_MAGIC, 4);
+    
+    IoSlice slices[2] = {{index, index_bytes}, {footer, sizeof(footer)}};
+    if (container_write(w, slices, 2) != 0) {
+        status = -1;
+    }
+    w->offset += index_bytes + sizeof(footer);
+    
+    free(index);
+    free(w->entries);
+    w->entries = NULL;
+    return status;
+}
+
 /**
- * Run-Length Encoding (RLE) Compression
+ * Load the chunk index of a container: one seek to the footer, one to the index
+ * Every chunk is checked to lie between the file header and the index, in
+ * increasing file order without overlap, so readers can trust the offsets.
+ * Returns 0 on success, -1 (with a message) if the file is not a valid container
+ */
+int container_read_index(FILE *file, ContainerIndex *idx) {
+    unsigned char header[CONTAINER_HEADER_SIZE];
+    unsigned char footer[FOOTER_SIZE];
+    
+    memset(idx, 0, sizeof(*idx));
+    
+    if (file_seek(file, 0, SEEK_SET) != 0 ||
+        fread(header, 1, sizeof(header), file) != sizeof(header) ||
+        memcmp(header, CONTAINER_MAGIC, 4) != 0) {
+        fprintf(stderr, "Error: Not a compressed container (bad magic)\n");
+        return -1;
+    }
+    if (get_u16(header + 4) != CONTAINER_VERSION) {
+        fprintf(stderr, "Error: Unsupported container version %u\n", get_u16(header + 4));
+        return -1;
+    }
+    idx->chunk_size = get_u32(header + 8);
+    
+    if (file_seek(file, -(long)FOOTER_SIZE, SEEK_END) != 0) {
+        fprintf(stderr, "Error: Container is truncated\n");
+        return -1;
+    }
+    uint64_t footer_offset = (uint64_t)file_tell(file);
+    if (fread(footer, 1, sizeof(footer), file) != sizeof(footer) ||
+        memcmp(footer + 28, CONTAINER_INDEX_MAGIC, 4) != 0) {
+        fprintf(stderr, "Error: Container footer is missing or corrupt\n");
+        return -1;
+    }
+    
+    uint64_t index_offset = get_u64(footer);
+    uint64_t count = get_u64(footer + 8);
+    if (index_offset < CONTAINER_HEADER_SIZE || index_offset > footer_offset ||
+        (footer_offset - index_offset) / INDEX_ENTRY_SIZE != count ||
+        (footer_offset - index_offset) % INDEX_ENTRY_SIZE != 0) {
+        fprintf(stderr, "Error: Container index bounds are invalid\n");
+        return -1;
+    }
+    
+    size_t index_bytes = (size_t)count * INDEX_ENTRY_SIZE;
+    unsigned char *index = (unsigned char *)malloc(index_bytes ? index_bytes : 1);
+    idx->entries = (ChunkIndexEntry *)malloc((count ? count : 1) * sizeof(ChunkIndexEntry));
+    if (!index || !idx->entries) {
+        fprintf(stderr, "Error: Out of memory reading container index\n");
+        free(index);
+        free(idx->entries);
+        idx->entries = NULL;
+        return -1;
+    }
+    
+    if (file_seek(file, (long long)index_offset, SEEK_SET) != 0 ||
+        fread(index, 1, index_bytes, file) != index_bytes ||
+        crc32_update(0, index, index_bytes) != get_u32(footer + 24)) {
+        fprintf(stderr, "Error: Container index is corrupt\n");
+        free(index);
+        free(idx->entries);
+        idx->entries = NULL;
+        return -1;
+    }
+    
+    // First byte the next chunk may start at; the tests are written as
+    // subtractions from index_offset so no sum can wrap around
+    uint64_t chunk_floor = CONTAINER_HEADER_SIZE;
+    for (uint64_t i = 0; i < count; i++) {
+        const unsigned char *p = index + i * INDEX_ENTRY_SIZE;
+        ChunkIndexEntry *e = &idx->entries[i];
+        e->file_offset = get_u64(p);
+        e->raw_offset = get_u64(p + 8);
+        e->raw_size = get_u32(p + 16);
+        e->compressed_size = get_u32(p + 20);
+        e->checksum = get_u32(p + 24);
+        e->codec = get_u16(p + 28);
+        e->flags = get_u16(p + 30);
+        
+        if (e->file_offset < chunk_floor || index_offset < CHUNK_HEADER_SIZE ||
+            e->file_offset > index_offset - CHUNK_HEADER_SIZE ||
+            e->compressed_size > index_offset - CHUNK_HEADER_SIZE - e->file_offset) {
+            fprintf(stderr, "Error: Container index entry %llu is out of bounds\n", (unsigned long long)i);
+            free(index);
+            free(idx->entries);
+            idx->entries = NULL;
+            return -1;
+        }
+        chunk_floor = e->file_offset + CHUNK_HEADER_SIZE + e->compressed_size;
+    }
+    
+    free(index);
+    idx->count = count;
+    idx->raw_total = get_u64(footer + 16);
+    idx->index_offset = index_offset;
+    return 0;
+}
+
+/**
+ * Release a loaded index
+ */
+void container_free_index(ContainerIndex *idx) {
+    free(idx->entries);
+    idx->entries = NULL;
+    idx->count = 0;
+}
+
+/**
+ * Text Run-Length Encoding (original format, CODEC_RLE_TEXT)
  * 
  * Compresses data by encoding consecutive repeating characters as:
  * count + character
  * 
- * Example: "AAABBBCC" -> "3A3B2C"
+ * Example: "AAABBBCC" -> "3A3BCC"
+ * 
+ * '@' and the digits 3-9 are never written as plain literals, so a digit
+ * always starts a short run and decoding is unambiguous.
  */
-int compress_rle(const char *input, int input_size, char *output, int max_output_size) {
+size_t compress_rle_text(const char *input, size_t input_size, char *output, size_t max_output_size) {
     if (input_size == 0) return 0;
     
-    int out_pos = 0;
-    int i = 0;
+    size_t out_pos = 0;
+    size_t i = 0;
     
     while (i < input_size && out_pos < max_output_size - 10) {
         char current = input[i];
@@ -62,8 +524,8 @@ int compress_rle(const char *input, int input_size, char *output, int max_output
                 out_pos += snprintf(output + out_pos, max_output_size - out_pos, 
                                    "@%c%c", (char)count, current);
             }
-        } else if (current == '@') {
-            // Special handling for @ character
+        } else if (current == '@' || (current >= '3' && current <= '9')) {
+            // Special handling for @ and digits that would read as a count
             out_pos += snprintf(output + out_pos, max_output_size - out_pos, 
                                "@%c%c", (char)count, current);
         } else {
@@ -80,216 +542,2030 @@ int compress_rle(const char *input, int input_size, char *output, int max_output
     return out_pos;
 }
 
-/**
- * Task 1: Read file chunk
- */
-void read_chunk(FILE *input_file, Chunk *chunk, int chunk_id) {
-    chunk->chunk_id = chunk_id;
-    chunk->data = (char *)malloc(CHUNK_SIZE);
+/**
+ * Text Run-Length Decoding: inverse of compress_rle_text
+ * Returns the number of bytes written, or -1 if the input is malformed
+ * or would not fit in max_output_size
+ */
+long long decompress_rle_text(const char *input, size_t input_size, char *output, size_t max_output_size) {
+    const unsigned char *in = (const unsigned char *)input;
+    size_t in_pos = 0;
+    size_t out_pos = 0;
+    
+    while (in_pos < input_size) {
+        unsigned char c = in[in_pos];
+        int count = 1;
+        char value = (char)c;
+        
+        if (c == '@') {
+            if (in_pos + 2 >= input_size) return -1;
+            count = in[in_pos + 1];
+            value = (char)in[in_pos + 2];
+            in_pos += 3;
+        } else if (c >= '3' && c <= '9') {
+            if (in_pos + 1 >= input_size) return -1;
+            count = c - '0';
+            value = (char)in[in_pos + 1];
+            in_pos += 2;
+        } else {
+            in_pos++;
+        }
+        
+        if ((size_t)count > max_output_size - out_pos) return -1;
+        memset(output + out_pos, value, count);
+        out_pos += count;
+    }
+    
+    return (long long)out_pos;
+}
+
+/*
+ * PackBits-style RLE (CODEC_RLE)
+ * 
+ * The stream is a sequence of control bytes, each followed by its data:
+ *   0x00-0x7F  literal: the next c + 1 bytes (1-128) are copied as-is
+ *   0x80-0xFF  run: the next byte repeated (c - 0x80) + 3 times (3-130)
+ * Every byte value is legal data, so the format needs no escapes and
+ * expands incompressible input by at most 1 byte in 128.
+ */
+#define RLE_MAX_LITERAL 128
+#define RLE_MIN_RUN 3
+#define RLE_MAX_RUN 130
+
+// Scanners: how many bytes equal p[0] in p[0..n), and where in p[0..n) the
+// first run of RLE_MIN_RUN equal bytes starts (n if none)
+typedef size_t (*run_scan_fn)(const unsigned char *p, size_t n);
+
+// Profile for the codec chooser in a single pass: add every byte of p[0..n)
+// to four interleaved histograms and return how many positions start a triple
+typedef size_t (*profile_fn)(const unsigned char *p, size_t n, uint32_t hist[4][256]);
+
+typedef struct {
+    const char *name;
+    run_scan_fn run_length;
+    run_scan_fn run_start;
+    profile_fn profile;
+} RleScanner;
+
+static size_t run_length_scalar(const unsigned char *p, size_t n) {
+    size_t i = 1;
+    while (i < n && p[i] == p[0]) i++;
+    return i;
+}
+
+static size_t run_start_scalar(const unsigned char *p, size_t n) {
+    for (size_t i = 0; i + 2 < n; i++) {
+        if (p[i] == p[i + 1] && p[i] == p[i + 2]) return i;
+    }
+    return n;
+}
+
+// Four interleaved histograms so repeated bytes do not serialise on one counter
+static size_t profile_scalar(const unsigned char *p, size_t n, uint32_t hist[4][256]) {
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 2 < n; i++) {
+        hist[i & 3][p[i]]++;
+        count += (p[i] == p[i + 1] && p[i] == p[i + 2]);
+    }
+    for (; i < n; i++) hist[i & 3][p[i]]++;
+    return count;
+}
+
+#ifdef HAVE_SIMD_SCAN
+// 16 bytes per compare: first mismatch is the lowest clear bit of the mask
+__attribute__((target("sse2")))
+static size_t run_length_sse2(const unsigned char *p, size_t n) {
+    __m128i c = _mm_set1_epi8((char)p[0]);
+    size_t i = 1;
+    for (; i + 16 <= n; i += 16) {
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + i)), c));
+        if (mask != 0xFFFF) return i + __builtin_ctz(~mask);
+    }
+    while (i < n && p[i] == p[0]) i++;
+    return i;
+}
+
+// Compare the block with itself shifted by 1 and 2: a set bit marks p[i] == p[i+1] == p[i+2]
+__attribute__((target("sse2")))
+static size_t run_start_sse2(const unsigned char *p, size_t n) {
+    size_t i = 0;
+    for (; i + 18 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(p + i + 1));
+        __m128i c = _mm_loadu_si128((const __m128i *)(p + i + 2));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, b), _mm_cmpeq_epi8(b, c)));
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    return i + run_start_scalar(p + i, n - i);
+}
+
+// Triple mask and histogram of the same 16 bytes while they are in cache
+__attribute__((target("sse2")))
+static size_t profile_sse2(const unsigned char *p, size_t n, uint32_t hist[4][256]) {
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 18 <= n; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(p + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(p + i + 1));
+        __m128i c = _mm_loadu_si128((const __m128i *)(p + i + 2));
+        count += __builtin_popcount((unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, b), _mm_cmpeq_epi8(b, c))));
+        for (size_t k = i; k < i + 16; k += 4) {
+            hist[0][p[k]]++;
+            hist[1][p[k + 1]]++;
+            hist[2][p[k + 2]]++;
+            hist[3][p[k + 3]]++;
+        }
+    }
+    return count + profile_scalar(p + i, n - i, hist);
+}
+
+__attribute__((target("avx2")))
+static size_t run_length_avx2(const unsigned char *p, size_t n) {
+    __m256i c = _mm256_set1_epi8((char)p[0]);
+    size_t i = 1;
+    for (; i + 32 <= n; i += 32) {
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + i)), c));
+        if (mask != 0xFFFFFFFFu) return i + __builtin_ctz(~mask);
+    }
+    while (i < n && p[i] == p[0]) i++;
+    return i;
+}
+
+__attribute__((target("avx2")))
+static size_t run_start_avx2(const unsigned char *p, size_t n) {
+    size_t i = 0;
+    for (; i + 34 <= n; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(p + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(p + i + 1));
+        __m256i c = _mm256_loadu_si256((const __m256i *)(p + i + 2));
+        unsigned mask = (unsigned)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, b), _mm256_cmpeq_epi8(b, c)));
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    return i + run_start_scalar(p + i, n - i);
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t profile_avx2(const unsigned char *p, size_t n, uint32_t hist[4][256]) {
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 34 <= n; i += 32) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(p + i));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(p + i + 1));
+        __m256i c = _mm256_loadu_si256((const __m256i *)(p + i + 2));
+        count += __builtin_popcount((unsigned)_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, b), _mm256_cmpeq_epi8(b, c))));
+        for (size_t k = i; k < i + 32; k += 4) {
+            hist[0][p[k]]++;
+            hist[1][p[k + 1]]++;
+            hist[2][p[k + 2]]++;
+            hist[3][p[k + 3]]++;
+        }
+    }
+    return count + profile_scalar(p + i, n - i, hist);
+}
+#endif
+
+static const RleScanner rle_scanners[] = {
+    {"scalar", run_length_scalar, run_start_scalar, profile_scalar},
+#ifdef HAVE_SIMD_SCAN
+    {"sse2", run_length_sse2, run_start_sse2, profile_sse2},
+    {"avx2", run_length_avx2, run_start_avx2, profile_avx2},
+#endif
+};
+static const RleScanner *rle_scanner = &rle_scanners[0];
+
+/**
+ * Pick the widest run scanner the CPU supports
+ * Returns the scanner name for reporting
+ */
+const char *select_rle_scanner(void) {
+#ifdef HAVE_SIMD_SCAN
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        rle_scanner = &rle_scanners[2];
+    } else if (__builtin_cpu_supports("sse2")) {
+        rle_scanner = &rle_scanners[1];
+    }
+#endif
+    return rle_scanner->name;
+}
+
+// PackBits encoder over an explicit scanner (the benchmark compares them)
+static size_t rle_encode(const RleScanner *scan, const unsigned char *in, size_t n, unsigned char *out) {
+    size_t i = 0;
+    size_t o = 0;
+    
+    while (i < n) {
+        size_t left = n - i;
+        size_t run = scan->run_length(in + i, left < RLE_MAX_RUN ? left : RLE_MAX_RUN);
+        
+        if (run >= RLE_MIN_RUN) {
+            out[o++] = (unsigned char)(0x80 + run - RLE_MIN_RUN);
+            out[o++] = in[i];
+            i += run;
+            continue;
+        }
+        
+        // Literal up to the next run start (a run may begin in the last 2 bytes
+        // of the window and continue past it, so scan 2 bytes further)
+        size_t window = left < RLE_MAX_LITERAL + 2 ? left : RLE_MAX_LITERAL + 2;
+        size_t lit = scan->run_start(in + i, window);
+        if (lit > RLE_MAX_LITERAL) lit = RLE_MAX_LITERAL;
+        if (lit > left) lit = left;
+        
+        out[o++] = (unsigned char)(lit - 1);
+        memcpy(out + o, in + i, lit);
+        o += lit;
+        i += lit;
+    }
+    
+    return o;
+}
+
+/**
+ * Run-Length Encoding (PackBits-style, CODEC_RLE)
+ * 
+ * Example: "AAAAABCD" -> [0x82 'A'] [0x02 'B' 'C' 'D']
+ * output must hold RLE_BOUND(input_size) bytes. Returns the encoded size.
+ */
+size_t compress_rle(const char *input, size_t input_size, char *output) {
+    return rle_encode(rle_scanner, (const unsigned char *)input, input_size, (unsigned char *)output);
+}
+
+/**
+ * Run-Length Decoding: inverse of compress_rle
+ * Returns the number of bytes written, or -1 if the input is malformed
+ * or would not fit in max_output_size
+ */
+long long decompress_rle(const char *input, size_t input_size, char *output, size_t max_output_size) {
+    const unsigned char *in = (const unsigned char *)input;
+    size_t i = 0;
+    size_t o = 0;
+    
+    while (i < input_size) {
+        unsigned c = in[i++];
+        
+        if (c < 0x80) {
+            size_t lit = c + 1;
+            if (lit > input_size - i || lit > max_output_size - o) return -1;
+            memcpy(output + o, in + i, lit);
+            i += lit;
+            o += lit;
+        } else {
+            size_t run = c - 0x80 + RLE_MIN_RUN;
+            if (i >= input_size || run > max_output_size - o) return -1;
+            memset(output + o, in[i++], run);
+            o += run;
+        }
+    }
+    
+    return (long long)o;
+}
+
+/*
+ * Buffer memory
+ * 
+ * Pool and scratch buffers start on a cache line, so buffers used by
+ * different threads never share one.
+ */
+void *aligned_buffer(size_t size) {
+#ifdef _WIN32
+    return _aligned_malloc(size ? size : 1, CACHE_LINE);
+#else
+    void *p = NULL;
+    return (posix_memalign(&p, CACHE_LINE, size ? size : 1) == 0) ? p : NULL;
+#endif
+}
+
+void aligned_buffer_free(void *p) {
+#ifdef _WIN32
+    _aligned_free(p);
+#else
+    free(p);
+#endif
+}
+
+// Per-thread codec working memory (hash chains, Huffman tables, the LZ
+// stage of lzh), allocated on a thread's first use and then reused
+#define SCRATCH_LZ_TABLES 0
+#define SCRATCH_HUFF_TABLE 1
+#define SCRATCH_STAGE 2
+#define SCRATCH_SLOTS 3
+
+static struct {
+    void *buffer[SCRATCH_SLOTS];
+    size_t size[SCRATCH_SLOTS];
+} scratch;
+#pragma omp threadprivate(scratch)
+
+// Returns this thread's scratch buffer for slot, at least size bytes (NULL if out of memory)
+static void *scratch_get(int slot, size_t size) {
+    if (scratch.size[slot] < size) {
+        aligned_buffer_free(scratch.buffer[slot]);
+        scratch.buffer[slot] = aligned_buffer(size);
+        scratch.size[slot] = scratch.buffer[slot] ? size : 0;
+    }
+    return scratch.buffer[slot];
+}
+
+/*
+ * LZ77 (CODEC_LZ)
+ * 
+ * Byte-oriented sequences in the style of LZ4. Each sequence is
+ *   token       high nibble: literal count, low nibble: match length - 4
+ *               (15 in either nibble means "add the following bytes, each
+ *               255 continues")
+ *   literals
+ *   u16 offset  distance back to the match, 1-65535 (little-endian)
+ *   match length continuation bytes
+ * The last sequence has literals only and ends the stream. Matches are
+ * found with a hash chain over a 64 KB window.
+ */
+#define LZ_MIN_MATCH 4
+#define LZ_WINDOW (1 << 16)
+#define LZ_HASH_BITS 15
+#define LZ_MAX_CHAIN 16  // Candidates tried per position: ratio vs speed
+
+#define LZ_BOUND(n) ((n) + (n) / 255 + 16)
+
+static uint32_t lz_hash(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// Length continuation: 255 means "add and keep reading"
+static size_t lz_put_length(unsigned char *out, size_t o, size_t len) {
+    while (len >= 255) {
+        out[o++] = 255;
+        len -= 255;
+    }
+    out[o++] = (unsigned char)len;
+    return o;
+}
+
+static size_t lz_put_sequence(unsigned char *out, size_t o, const unsigned char *lit, size_t lit_len,
+                              size_t offset, size_t match_len) {
+    size_t ml = match_len ? match_len - LZ_MIN_MATCH : 0;
+    out[o++] = (unsigned char)(((lit_len < 15 ? lit_len : 15) << 4) | (ml < 15 ? ml : 15));
+    if (lit_len >= 15) o = lz_put_length(out, o, lit_len - 15);
+    memcpy(out + o, lit, lit_len);
+    o += lit_len;
+    
+    if (match_len) {
+        put_u16(out + o, (uint16_t)offset);
+        o += 2;
+        if (ml >= 15) o = lz_put_length(out, o, ml - 15);
+    }
+    return o;
+}
+
+static size_t lz_compress(const char *input, size_t n, char *output) {
+    const unsigned char *in = (const unsigned char *)input;
+    unsigned char *out = (unsigned char *)output;
+    int32_t *head = (int32_t *)scratch_get(SCRATCH_LZ_TABLES,
+                                           ((1 << LZ_HASH_BITS) + LZ_WINDOW) * sizeof(int32_t));
+    size_t o = 0, anchor = 0, i = 0;
+    
+    if (!head) return 0;
+    int32_t *prev = head + (1 << LZ_HASH_BITS);
+    memset(head, -1, (1 << LZ_HASH_BITS) * sizeof(int32_t));
+    
+    while (n >= LZ_MIN_MATCH && i + LZ_MIN_MATCH <= n) {
+        uint32_t h = lz_hash(in + i);
+        int32_t cand = head[h];
+        size_t best_len = 0, best_off = 0;
+        
+        // Walk the chain of earlier positions with the same hash
+        for (int depth = 0; cand >= 0 && i - (size_t)cand < LZ_WINDOW && depth < LZ_MAX_CHAIN; depth++) {
+            const unsigned char *a = in + cand, *b = in + i;
+            size_t len = 0, max = n - i;
+            while (len < max && a[len] == b[len]) len++;
+            if (len > best_len) {
+                best_len = len;
+                best_off = i - (size_t)cand;
+                if (len == max) break;
+            }
+            cand = prev[cand & (LZ_WINDOW - 1)];
+        }
+        
+        prev[i & (LZ_WINDOW - 1)] = head[h];
+        head[h] = (int32_t)i;
+        
+        if (best_len < LZ_MIN_MATCH) {
+            i++;
+            continue;
+        }
+        
+        o = lz_put_sequence(out, o, in + anchor, i - anchor, best_off, best_len);
+        
+        // Index the positions inside the match so later data can refer to them
+        size_t end = i + best_len;
+        for (i++; i < end && i + LZ_MIN_MATCH <= n; i++) {
+            uint32_t hi = lz_hash(in + i);
+            prev[i & (LZ_WINDOW - 1)] = head[hi];
+            head[hi] = (int32_t)i;
+        }
+        i = end;
+        anchor = end;
+    }
+    
+    return lz_put_sequence(out, o, in + anchor, n - anchor, 0, 0);
+}
+
+// Read a length continuation; returns -1 if the input ends first
+static long long lz_get_length(const unsigned char *in, size_t n, size_t *i) {
+    size_t len = 0;
+    unsigned char b;
+    do {
+        if (*i >= n) return -1;
+        b = in[(*i)++];
+        len += b;
+    } while (b == 255);
+    return (long long)len;
+}
+
+static long long lz_decompress(const char *input, size_t n, char *output, size_t cap) {
+    const unsigned char *in = (const unsigned char *)input;
+    unsigned char *out = (unsigned char *)output;
+    size_t i = 0, o = 0;
+    
+    while (i < n) {
+        unsigned token = in[i++];
+        size_t lit = token >> 4;
+        if (lit == 15) {
+            long long extra = lz_get_length(in, n, &i);
+            if (extra < 0) return -1;
+            lit += (size_t)extra;
+        }
+        if (lit > n - i || lit > cap - o) return -1;
+        memcpy(out + o, in + i, lit);
+        i += lit;
+        o += lit;
+        
+        if (i == n) break;  // Final sequence: literals only
+        
+        if (n - i < 2) return -1;
+        size_t offset = get_u16(in + i);
+        i += 2;
+        size_t len = (token & 15);
+        if (len == 15) {
+            long long extra = lz_get_length(in, n, &i);
+            if (extra < 0) return -1;
+            len += (size_t)extra;
+        }
+        len += LZ_MIN_MATCH;
+        if (offset == 0 || offset > o || len > cap - o) return -1;
+        
+        // Overlapping copies (offset < len) repeat the pattern, so go byte by byte
+        const unsigned char *src = out + o - offset;
+        if (offset >= len) {
+            memcpy(out + o, src, len);
+        } else {
+            for (size_t k = 0; k < len; k++) out[o + k] = src[k];
+        }
+        o += len;
+    }
+    
+    return (long long)o;
+}
+
+/*
+ * Canonical Huffman (CODEC_HUFFMAN)
+ * 
+ * Order-0 byte coder. Stream layout:
+ *   u32        number of decoded bytes
+ *   128 bytes  code length of each byte value, two 4-bit lengths per byte
+ *   bitstream  codes packed LSB-first
+ * Only code lengths are stored: canonical codes are rebuilt from them, so
+ * the table costs 128 bytes whatever the data. Lengths are limited to 15
+ * bits by flattening the counts until the tree is shallow enough.
+ */
+#define HUFF_MAX_BITS 15
+#define HUFF_HEADER 132
+
+#define HUFF_BOUND(n) (HUFF_HEADER + ((n) * HUFF_MAX_BITS + 7) / 8 + 8)
+
+// Code lengths from byte counts (two-queue Huffman construction)
+static void huff_build_lengths(const uint32_t count[256], unsigned char len[256]) {
+    uint32_t freq[256];
+    int sym[256], parent[512], depth[512];
+    uint64_t weight[512];
+    
+    memcpy(freq, count, sizeof(freq));
+    memset(len, 0, 256);
+    
+    for (;;) {
+        int n = 0;
+        for (int s = 0; s < 256; s++) {
+            if (freq[s]) sym[n++] = s;
+        }
+        if (n == 0) return;
+        if (n == 1) {
+            len[sym[0]] = 1;
+            return;
+        }
+        
+        // Leaves in ascending frequency order
+        for (int a = 1; a < n; a++) {
+            int s = sym[a], b = a;
+            while (b > 0 && freq[sym[b - 1]] > freq[s]) {
+                sym[b] = sym[b - 1];
+                b--;
+            }
+            sym[b] = s;
+        }
+        for (int a = 0; a < n; a++) weight[a] = freq[sym[a]];
+        
+        // Merge the two lightest of (next leaf, next internal node) n - 1 times
+        int leaf = 0, inner = n, next = n;
+        for (int k = 0; k < n - 1; k++) {
+            int pick[2];
+            for (int t = 0; t < 2; t++) {
+                if (leaf < n && (inner >= next || weight[leaf] <= weight[inner])) {
+                    pick[t] = leaf++;
+                } else {
+                    pick[t] = inner++;
+                }
+            }
+            weight[next] = weight[pick[0]] + weight[pick[1]];
+            parent[pick[0]] = parent[pick[1]] = next;
+            next++;
+        }
+        
+        int max_depth = 0;
+        depth[next - 1] = 0;
+        for (int node = next - 2; node >= 0; node--) {
+            depth[node] = depth[parent[node]] + 1;
+        }
+        for (int a = 0; a < n; a++) {
+            if (depth[a] > max_depth) max_depth = depth[a];
+        }
+        
+        if (max_depth <= HUFF_MAX_BITS) {
+            for (int a = 0; a < n; a++) len[sym[a]] = (unsigned char)depth[a];
+            return;
+        }
+        
+        // Too deep: flatten the distribution and rebuild
+        for (int s = 0; s < 256; s++) {
+            if (freq[s]) freq[s] = (freq[s] + 1) / 2;
+        }
+    }
+}
+
+// Canonical codes, bit-reversed for LSB-first output; returns 0 if the lengths are invalid
+static int huff_codes(const unsigned char len[256], uint16_t code[256]) {
+    int bl_count[HUFF_MAX_BITS + 1] = {0};
+    uint32_t next_code[HUFF_MAX_BITS + 1];
+    uint32_t c = 0;
+    uint32_t kraft = 0;
+    
+    for (int s = 0; s < 256; s++) {
+        if (len[s] > HUFF_MAX_BITS) return 0;
+        if (len[s]) {
+            bl_count[len[s]]++;
+            kraft += 1u << (HUFF_MAX_BITS - len[s]);
+        }
+    }
+    if (kraft > (1u << HUFF_MAX_BITS)) return 0;
+    
+    for (int bits = 1; bits <= HUFF_MAX_BITS; bits++) {
+        next_code[bits] = c;
+        c = (c + bl_count[bits]) << 1;
+    }
+    
+    for (int s = 0; s < 256; s++) {
+        code[s] = 0;
+        if (!len[s]) continue;
+        uint32_t v = next_code[len[s]]++, r = 0;
+        for (int b = 0; b < len[s]; b++) r |= ((v >> b) & 1) << (len[s] - 1 - b);
+        code[s] = (uint16_t)r;
+    }
+    return 1;
+}
+
+static size_t huff_compress(const char *input, size_t n, char *output) {
+    const unsigned char *in = (const unsigned char *)input;
+    unsigned char *out = (unsigned char *)output;
+    uint32_t count[256] = {0};
+    unsigned char len[256];
+    uint16_t code[256];
+    
+    for (size_t i = 0; i < n; i++) count[in[i]]++;
+    huff_build_lengths(count, len);
+    huff_codes(len, code);
+    
+    put_u32(out, (uint32_t)n);
+    for (int s = 0; s < 256; s += 2) {
+        out[4 + s / 2] = (unsigned char)(len[s] | (len[s + 1] << 4));
+    }
+    
+    // 64-bit accumulator, flushed a byte at a time
+    size_t o = HUFF_HEADER;
+    uint64_t acc = 0;
+    int bits = 0;
+    for (size_t i = 0; i < n; i++) {
+        acc |= (uint64_t)code[in[i]] << bits;
+        bits += len[in[i]];
+        while (bits >= 8) {
+            out[o++] = (unsigned char)acc;
+            acc >>= 8;
+            bits -= 8;
+        }
+    }
+    if (bits > 0) out[o++] = (unsigned char)acc;
+    return o;
+}
+
+static long long huff_decompress(const char *input, size_t n, char *output, size_t cap) {
+    const unsigned char *in = (const unsigned char *)input;
+    unsigned char *out = (unsigned char *)output;
+    unsigned char len[256];
+    uint16_t code[256];
+    
+    if (n < HUFF_HEADER) return -1;
+    size_t count = get_u32(in);
+    if (count > cap) return -1;
+    for (int s = 0; s < 256; s += 2) {
+        len[s] = in[4 + s / 2] & 15;
+        len[s + 1] = in[4 + s / 2] >> 4;
+    }
+    if (!huff_codes(len, code)) return -1;
+    
+    // Direct lookup on the next 15 bits: entry = symbol << 4 | length (0 = invalid)
+    uint16_t *table = (uint16_t *)scratch_get(SCRATCH_HUFF_TABLE, (1 << HUFF_MAX_BITS) * sizeof(uint16_t));
+    if (!table) return -1;
+    memset(table, 0, (1 << HUFF_MAX_BITS) * sizeof(uint16_t));
+    for (int s = 0; s < 256; s++) {
+        if (!len[s]) continue;
+        for (uint32_t k = code[s]; k < (1u << HUFF_MAX_BITS); k += 1u << len[s]) {
+            table[k] = (uint16_t)((s << 4) | len[s]);
+        }
+    }
+    
+    const unsigned char *p = in + HUFF_HEADER;
+    const unsigned char *end = in + n;
+    uint64_t acc = 0;
+    int bits = 0;       // Bits in acc
+    int overrun = 0;    // Padding bits added past the end of the input
+    
+    for (size_t o = 0; o < count; o++) {
+        while (bits <= 56) {
+            if (p < end) {
+                acc |= (uint64_t)*p++ << bits;
+            } else {
+                overrun += 8;
+            }
+            bits += 8;
+        }
+        uint16_t entry = table[acc & ((1u << HUFF_MAX_BITS) - 1)];
+        int l = entry & 15;
+        if (l == 0) return -1;
+        out[o] = (unsigned char)(entry >> 4);
+        acc >>= l;
+        bits -= l;
+    }
+    
+    // Every consumed bit must have come from the input
+    if (overrun > bits) return -1;
+    return (long long)count;
+}
+
+/*
+ * LZ77 followed by Huffman coding of the LZ stream (CODEC_LZ_HUFFMAN)
+ */
+#define LZH_BOUND(n) HUFF_BOUND(LZ_BOUND(n))
+
+static size_t lzh_compress(const char *input, size_t n, char *output) {
+    char *lz = (char *)scratch_get(SCRATCH_STAGE, LZ_BOUND(n));
+    if (!lz) return 0;
+    size_t m = lz_compress(input, n, lz);
+    return (m || !n) ? huff_compress(lz, m, output) : 0;
+}
+
+static long long lzh_decompress(const char *input, size_t n, char *output, size_t cap) {
+    if (n < HUFF_HEADER) return -1;
+    size_t m = get_u32((const unsigned char *)input);
+    if (m > LZ_BOUND(cap)) return -1;
+    
+    char *lz = (char *)scratch_get(SCRATCH_STAGE, m ? m : 1);
+    if (!lz) return -1;
+    long long got = huff_decompress(input, n, lz, m);
+    return (got == (long long)m) ? lz_decompress(lz, m, output, cap) : -1;
+}
+
+/*
+ * Codec table
+ * 
+ * compress writes at most bound(n) bytes and returns the size (0 means
+ * failure for n > 0); decompress returns the decoded size or -1. The id is
+ * stored with every chunk, so the decompressor picks the codec itself.
+ */
+typedef struct {
+    const char *name;
+    uint16_t id;
+    size_t (*bound)(size_t n);
+    size_t (*compress)(const char *input, size_t n, char *output);
+    long long (*decompress)(const char *input, size_t n, char *output, size_t cap);
+} Codec;
+
+static size_t rle_text_bound(size_t n) { return RLE_TEXT_BOUND(n); }
+static size_t rle_bound(size_t n) { return RLE_BOUND(n); }
+static size_t lz_bound(size_t n) { return LZ_BOUND(n); }
+static size_t huff_bound(size_t n) { return HUFF_BOUND(n); }
+static size_t lzh_bound(size_t n) { return LZH_BOUND(n); }
+
+static size_t stored_bound(size_t n) { return n; }
+
+static size_t rle_text_compress(const char *input, size_t n, char *output) {
+    return compress_rle_text(input, n, output, RLE_TEXT_BOUND(n));
+}
+
+static size_t stored_compress(const char *input, size_t n, char *output) {
+    memcpy(output, input, n);
+    return n;
+}
+
+static long long stored_decompress(const char *input, size_t n, char *output, size_t cap) {
+    if (n > cap) return -1;
+    memcpy(output, input, n);
+    return (long long)n;
+}
+
+static const Codec codecs[] = {
+    {"rle", CODEC_RLE, rle_bound, compress_rle, decompress_rle},
+    {"lz", CODEC_LZ, lz_bound, lz_compress, lz_decompress},
+    {"huffman", CODEC_HUFFMAN, huff_bound, huff_compress, huff_decompress},
+    {"lzh", CODEC_LZ_HUFFMAN, lzh_bound, lzh_compress, lzh_decompress},
+    {"rle-text", CODEC_RLE_TEXT, rle_text_bound, rle_text_compress, decompress_rle_text},
+    {"stored", CODEC_STORED, stored_bound, stored_compress, stored_decompress},
+};
+#define NUM_CODECS ((int)(sizeof(codecs) / sizeof(codecs[0])))
+
+static const Codec *active_codec = NULL;  // Chosen with --codec; NULL picks one per chunk (auto)
+
+const Codec *codec_by_name(const char *name) {
+    for (int i = 0; i < NUM_CODECS; i++) {
+        if (strcmp(codecs[i].name, name) == 0) return &codecs[i];
+    }
+    return NULL;
+}
+
+const Codec *codec_by_id(uint16_t id) {
+    for (int i = 0; i < NUM_CODECS; i++) {
+        if (codecs[i].id == id) return &codecs[i];
+    }
+    return NULL;
+}
+
+/**
+ * Decode one chunk payload with the codec recorded in the container
+ * Returns the decoded size, or -1 for a corrupt payload or unknown codec
+ */
+long long decode_payload(uint16_t codec, const char *input, size_t input_size,
+                         char *output, size_t max_output_size) {
+    const Codec *c = codec_by_id(codec);
+    return c ? c->decompress(input, input_size, output, max_output_size) : -1;
+}
+
+/*
+ * Adaptive codec choice (--codec auto, the default)
+ * 
+ * A few evenly spaced windows of each chunk are sampled for the order-0
+ * byte entropy and the share of positions that start a run of 3 equal
+ * bytes. Run-heavy chunks go to RLE, near-random ones are stored without
+ * compressing at all, and the rest go to LZ77. If the chosen codec still
+ * expands the chunk, it is stored instead.
+ */
+#define SAMPLE_WINDOWS 4
+#define SAMPLE_WINDOW 4096
+#define AUTO_RUN_SHARE 0.30      // Run share at which RLE wins
+#define AUTO_STORED_ENTROPY 7.5  // Bits per byte above which compression is skipped
+
+// log2(x) for x > 0 to within about 0.01, without libm
+static double approx_log2(double x) {
+    union { double d; uint64_t u; } v;
+    v.d = x;
+    int e = (int)((v.u >> 52) & 0x7FF) - 1023;
+    v.u = (v.u & 0x000FFFFFFFFFFFFFull) | 0x3FF0000000000000ull;  // Mantissa in [1, 2)
+    double m = v.d - 1.0;
+    return e + m * (1.3465 - 0.3465 * m);
+}
+
+const Codec *choose_codec(const char *data, size_t n) {
+    const unsigned char *p = (const unsigned char *)data;
+    uint32_t hist[4][256];
+    size_t sampled = 0;
+    size_t runs = 0;
+    
+    memset(hist, 0, sizeof(hist));
+    for (int w = 0; w < SAMPLE_WINDOWS; w++) {
+        size_t len = (n < SAMPLE_WINDOW) ? n : SAMPLE_WINDOW;
+        size_t off = (n - len) * w / (SAMPLE_WINDOWS - 1);
+        
+        runs += rle_scanner->profile(p + off, len, hist);
+        sampled += len;
+        if (len == n) break;  // Small chunk: one window covers it all
+    }
+    if (sampled == 0) return codec_by_id(CODEC_STORED);
+    
+    if ((double)runs / sampled >= AUTO_RUN_SHARE) return codec_by_id(CODEC_RLE);
+    
+    double entropy = 0.0;
+    for (int b = 0; b < 256; b++) {
+        uint32_t c = hist[0][b] + hist[1][b] + hist[2][b] + hist[3][b];
+        if (c) entropy += c * approx_log2((double)sampled / c);
+    }
+    entropy /= sampled;
+    
+    return codec_by_id(entropy >= AUTO_STORED_ENTROPY ? CODEC_STORED : CODEC_LZ);
+}
+
+// Worst-case output size of whatever choose_codec may pick
+static size_t auto_bound(size_t n) {
+    return (RLE_BOUND(n) > LZ_BOUND(n)) ? RLE_BOUND(n) : LZ_BOUND(n);
+}
+
+/**
+ * Open the compressor input, preferring mmap, then pread, then a stream
+ * 
+ * "-" reads standard input. Regular files are mapped read-only with a
+ * sequential-access hint (or read with pread if mapping fails); anything
+ * else (pipes, devices) is read sequentially. allow_mmap = 0 skips mmap.
+ */
+int input_open(InputSource *in, const char *filename, int allow_mmap) {
+    memset(in, 0, sizeof(*in));
+    in->fd = -1;
+    
+    if (strcmp(filename, "-") == 0) {
+#ifdef _WIN32
+        _setmode(_fileno(stdin), _O_BINARY);
+#endif
+        in->mode = INPUT_STREAM;
+        in->file = stdin;
+        return 0;
+    }
+
+#ifndef _WIN32
+    int fd = open(filename, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) close(fd);
+        fprintf(stderr, "Error: Cannot open input file '%s'\n", filename);
+        return -1;
+    }
+    
+    if (S_ISREG(st.st_mode)) {
+        in->fd = fd;
+        in->size = (uint64_t)st.st_size;
+        in->mode = INPUT_PREAD;
+        
+        if (allow_mmap && in->size > 0 && in->size <= (uint64_t)SIZE_MAX) {
+            void *map = mmap(NULL, (size_t)in->size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (map != MAP_FAILED) {
+                madvise(map, (size_t)in->size, MADV_SEQUENTIAL);
+                in->map = (char *)map;
+                in->mode = INPUT_MMAP;
+            }
+        }
+        return 0;
+    }
+    
+    // Not seekable: fall back to sequential reads
+    in->file = fdopen(fd, "rb");
+    if (!in->file) {
+        close(fd);
+        fprintf(stderr, "Error: Cannot open input file '%s'\n", filename);
+        return -1;
+    }
+    in->mode = INPUT_STREAM;
+    return 0;
+#else
+    (void)allow_mmap;
+    in->file = fopen(filename, "rb");
+    if (!in->file) {
+        fprintf(stderr, "Error: Cannot open input file '%s'\n", filename);
+        return -1;
+    }
+    in->mode = INPUT_STREAM;
+    return 0;
+#endif
+}
+
+/**
+ * Whether a path names a regular file that can be read a second time
+ */
+int is_regular_file(const char *filename) {
+    if (strcmp(filename, "-") == 0) return 0;
+#ifndef _WIN32
+    struct stat st;
+    return stat(filename, &st) == 0 && S_ISREG(st.st_mode);
+#else
+    return 1;
+#endif
+}
+
+/**
+ * Release the input (unmaps, closes the descriptor or stream)
+ */
+void input_close(InputSource *in) {
+#ifndef _WIN32
+    if (in->map) munmap(in->map, (size_t)in->size);
+    if (in->fd >= 0) close(in->fd);
+#endif
+    if (in->file && in->file != stdin) fclose(in->file);
+    memset(in, 0, sizeof(*in));
+    in->fd = -1;
+}
+
+#ifndef _WIN32
+/**
+ * pread until the buffer is full or the file ends
+ * Returns bytes read, or -1 on error
+ */
+static long long pread_full(int fd, char *buf, size_t size, uint64_t offset) {
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = pread(fd, buf + done, size - done, (off_t)(offset + done));
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (n == 0) break;
+        done += (size_t)n;
+    }
+    return (long long)done;
+}
+#endif
+
+/**
+ * Task 1: Read file chunk
+ * 
+ * Mapped input only records a slice; pread input may run for several
+ * chunks at once; stream input must be called in chunk order.
+ */
+void read_chunk(InputSource *in, Chunk *chunk, uint64_t chunk_id, size_t chunk_size) {
+    chunk->chunk_id = chunk_id;
+    chunk->raw_offset = chunk_id * chunk_size;
+    chunk->valid = 0;
+    
+    if (in->mode == INPUT_MMAP) {
+        if (chunk->raw_offset < in->size) {
+            uint64_t left = in->size - chunk->raw_offset;
+            chunk->data = in->map + chunk->raw_offset;
+            chunk->original_size = (left < chunk_size) ? (size_t)left : chunk_size;
+            chunk->valid = 1;
+        }
+        if (chunk->valid && pipeline_verbose) {
+            printf("[READ] Chunk %llu: Mapped %zu bytes\n",
+                   (unsigned long long)chunk_id, chunk->original_size);
+        }
+        return;
+    }
+    
+    chunk->data = chunk->in_buffer;
+    if (!chunk->data) {
+        fprintf(stderr, "Error: No input buffer for chunk %llu\n", (unsigned long long)chunk_id);
+        chunk->failed = 1;
+        return;
+    }
+    
+    size_t bytes_read;
+#ifndef _WIN32
+    if (in->mode == INPUT_PREAD) {
+        long long n = pread_full(in->fd, chunk->data, chunk_size, chunk->raw_offset);
+        if (n < 0) {
+            fprintf(stderr, "Error: Failed to read chunk %llu\n", (unsigned long long)chunk_id);
+            chunk->failed = 1;
+            return;
+        }
+        bytes_read = (size_t)n;
+    } else
+#endif
+    {
+        bytes_read = fread(chunk->data, 1, chunk_size, in->file);
+        if (bytes_read == 0 && ferror(in->file)) {
+            fprintf(stderr, "Error: Failed to read chunk %llu\n", (unsigned long long)chunk_id);
+            chunk->failed = 1;
+            return;
+        }
+    }
+    chunk->original_size = bytes_read;
+    chunk->valid = (bytes_read > 0);
+    
+    if (chunk->valid && pipeline_verbose) {
+        printf("[READ] Chunk %llu: Read %zu bytes\n", (unsigned long long)chunk_id, bytes_read);
+    }
+}
+
+/**
+ * Task 2: Compress chunk using RLE
+ */
+void compress_chunk(Chunk *chunk) {
+    if (!chunk->valid) return;
+    
+    double start_time = omp_get_wtime();
+    const Codec *codec = active_codec ? active_codec : choose_codec(chunk->data, chunk->original_size);
+    chunk->checksum = crc32_update(0, chunk->data, chunk->original_size);
+    
+    if (codec->id == CODEC_STORED) {
+        // Written straight from the input buffer; nothing to allocate or copy
+        chunk->compressed = NULL;
+        chunk->compressed_size = chunk->original_size;
+    } else {
+        // The slot's pool buffer holds the codec's worst case
+        chunk->compressed = chunk->out_buffer;
+        if (!chunk->compressed) {
+            fprintf(stderr, "Error: No output buffer for chunk %llu\n",
+                    (unsigned long long)chunk->chunk_id);
+            chunk->failed = 1;
+            return;
+        }
+        chunk->compressed_size = codec->compress(chunk->data, chunk->original_size, chunk->compressed);
+        
+        if (!active_codec && chunk->compressed_size >= chunk->original_size) {
+            chunk->compressed = NULL;
+            chunk->compressed_size = chunk->original_size;
+            codec = codec_by_id(CODEC_STORED);
+        }
+    }
+    chunk->codec = codec->id;
+    double end_time = omp_get_wtime();
+    
+    if (chunk->compressed_size == 0) {
+        fprintf(stderr, "Error: Codec %s failed on chunk %llu\n", codec->name,
+                (unsigned long long)chunk->chunk_id);
+        chunk->failed = 1;
+        return;
+    }
+    
+    double compression_ratio = (chunk->original_size > 0) ? 
+        (100.0 * chunk->compressed_size / chunk->original_size) : 0.0;
+    
+    if (pipeline_verbose) {
+        printf("[COMPRESS] Chunk %llu: %zu bytes -> %zu bytes (%s, %.1f%%, %.3f ms)\n",
+               (unsigned long long)chunk->chunk_id, chunk->original_size, chunk->compressed_size,
+               codec->name, compression_ratio, (end_time - start_time) * 1000);
+    }
+}
+
+/**
+ * Release a written chunk; its pool buffers stay with the slot for reuse
+ */
+void cleanup_chunk(Chunk *chunk) {
+    chunk->data = NULL;
+    chunk->compressed = NULL;
+}
+
+/*
+ * Chunk buffer pool
+ * 
+ * One cache-line aligned allocation, made before the pipeline starts and
+ * split between the ring slots: each slot owns an input buffer (none for
+ * mapped input, which is never copied) and a compressed buffer of the
+ * worst-case size. A chunk uses its slot's buffers and the slot is only
+ * reissued after that chunk has been written, so buffers are recycled as
+ * soon as they are written and nothing is allocated per chunk. Peak chunk
+ * memory is the window (PIPELINE_SLOTS) times the per-slot size.
+ */
+typedef struct {
+    char *memory;
+    size_t in_size;   // Per-slot input buffer (0 for mapped input)
+    size_t out_size;  // Per-slot compressed buffer
+} BufferPool;
+
+static size_t round_to_cache_line(size_t n) {
+    return (n + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+}
+
+int buffer_pool_init(BufferPool *pool, Chunk *slots, int count, size_t in_size, size_t out_size) {
+    pool->in_size = round_to_cache_line(in_size);
+    pool->out_size = round_to_cache_line(out_size);
+    pool->memory = (char *)aligned_buffer((pool->in_size + pool->out_size) * count);
+    if (!pool->memory) return -1;
     
-    int bytes_read = fread(chunk->data, 1, CHUNK_SIZE, input_file);
-    chunk->original_size = bytes_read;
-    chunk->valid = (bytes_read > 0);
-    
-    if (chunk->valid) {
-        printf("[READ] Chunk %d: Read %d bytes\n", chunk_id, bytes_read);
+    for (int i = 0; i < count; i++) {
+        char *base = pool->memory + (pool->in_size + pool->out_size) * i;
+        slots[i].in_buffer = pool->in_size ? base : NULL;
+        slots[i].out_buffer = pool->out_size ? base + pool->in_size : NULL;
     }
+    return 0;
+}
+
+void buffer_pool_destroy(BufferPool *pool) {
+    aligned_buffer_free(pool->memory);
+    pool->memory = NULL;
+}
+
+/*
+ * Task 3: ordered writer stage
+ * 
+ * Compress tasks hand finished chunks to a reorder buffer (the slot ring,
+ * chunk i in slot i % PIPELINE_SLOTS) in whatever order they complete.
+ * Whoever holds the writer role flushes the contiguous run starting at the
+ * next chunk to write with one vectored write and frees those slots. A task
+ * that finds the role taken just returns, so compress workers never wait
+ * for output; the current writer picks their chunks up on its next scan.
+ */
+typedef struct {
+    ContainerWriter *writer;
+    Chunk *slots;
+    uint64_t next_id;           // Next chunk_id to write
+    omp_lock_t lock;            // Protects ready flags and next_id
+    omp_lock_t writer_lock;     // Held by the thread acting as writer
+    int failed;                 // A chunk failed; later chunks are dropped (atomic)
+    uint64_t total_chunks;
+    uint64_t total_original_bytes;
+    uint64_t total_compressed_bytes;
+    uint64_t batches;           // Vectored writes issued
+} OrderedWriter;
+
+void ordered_writer_init(OrderedWriter *ow, ContainerWriter *writer, Chunk *slots) {
+    memset(ow, 0, sizeof(*ow));
+    ow->writer = writer;
+    ow->slots = slots;
+    omp_init_lock(&ow->lock);
+    omp_init_lock(&ow->writer_lock);
+}
+
+void ordered_writer_destroy(OrderedWriter *ow) {
+    omp_destroy_lock(&ow->lock);
+    omp_destroy_lock(&ow->writer_lock);
 }
 
 /**
- * Task 2: Compress chunk using RLE
+ * Write every contiguous ready chunk; caller holds writer_lock
  */
-void compress_chunk(Chunk *chunk) {
-    if (!chunk->valid) return;
-    
-    // Allocate memory for compressed data (worst case: 3x original size)
-    chunk->compressed = (char *)malloc(CHUNK_SIZE * 3);
-    
-    double start_time = omp_get_wtime();
-    chunk->compressed_size = compress_rle(chunk->data, chunk->original_size, 
-                                         chunk->compressed, CHUNK_SIZE * 3);
-    double end_time = omp_get_wtime();
-    
-    double compression_ratio = (chunk->original_size > 0) ? 
-        (100.0 * chunk->compressed_size / chunk->original_size) : 0.0;
+static void ordered_writer_flush(OrderedWriter *ow) {
+    Chunk *run[PIPELINE_SLOTS];
+    unsigned char headers[PIPELINE_SLOTS][CHUNK_HEADER_SIZE];
+    IoSlice slices[2 * PIPELINE_SLOTS];
     
-    printf("[COMPRESS] Chunk %d: %d bytes -> %d bytes (%.1f%%, %.3f ms)\n",
-           chunk->chunk_id, chunk->original_size, chunk->compressed_size,
-           compression_ratio, (end_time - start_time) * 1000);
+    for (;;) {
+        int n = 0;
+        omp_set_lock(&ow->lock);
+        while (n < PIPELINE_SLOTS && ow->slots[(ow->next_id + n) % PIPELINE_SLOTS].ready) {
+            run[n] = &ow->slots[(ow->next_id + n) % PIPELINE_SLOTS];
+            n++;
+        }
+        omp_unset_lock(&ow->lock);
+        if (n == 0) return;
+        
+        // One header + payload pair per chunk, all in a single write
+        int count = 0;
+        int written = 0;
+        for (int i = 0; i < n && !ow->failed; i++) {
+            Chunk *c = run[i];
+            if (c->failed) {
+                #pragma omp atomic write
+                ow->failed = 1;
+            } else if (c->valid) {
+                if (container_add_chunk(ow->writer, c, headers[i]) != 0) {
+                    fprintf(stderr, "Error: Out of memory indexing chunk %llu\n",
+                            (unsigned long long)c->chunk_id);
+                    #pragma omp atomic write
+                    ow->failed = 1;
+                    break;
+                }
+                slices[count].iov_base = headers[i];
+                slices[count++].iov_len = CHUNK_HEADER_SIZE;
+                // Stored chunks have no compressed copy; their payload is the input itself
+                slices[count].iov_base = c->compressed ? c->compressed : c->data;
+                slices[count++].iov_len = c->compressed_size;
+                written = i + 1;
+            }
+        }
+        
+        if (count > 0) {
+            if (container_write(ow->writer, slices, count) != 0) {
+                fprintf(stderr, "Error: Failed to write chunks %llu-%llu\n",
+                        (unsigned long long)run[0]->chunk_id,
+                        (unsigned long long)run[written - 1]->chunk_id);
+                #pragma omp atomic write
+                ow->failed = 1;
+            } else {
+                ow->batches++;
+                for (int i = 0; i < written; i++) {
+                    Chunk *c = run[i];
+                    if (!c->valid) continue;
+                    ow->total_chunks++;
+                    ow->total_original_bytes += c->original_size;
+                    ow->total_compressed_bytes += c->compressed_size;
+                    if (pipeline_verbose) {
+                        printf("[WRITE] Chunk %llu: Written %zu compressed bytes to output\n",
+                               (unsigned long long)c->chunk_id, c->compressed_size);
+                    }
+                }
+            }
+        }
+        
+        // Release the slots back to the producer
+        for (int i = 0; i < n; i++) {
+            cleanup_chunk(run[i]);
+        }
+        omp_set_lock(&ow->lock);
+        for (int i = 0; i < n; i++) {
+            run[i]->ready = 0;
+        }
+        ow->next_id += n;
+        omp_unset_lock(&ow->lock);
+    }
 }
 
 /**
- * Task 3: Write compressed chunk to output file
+ * Hand a finished chunk to the writer; never waits for another writer
  */
-void write_chunk(FILE *output_file, Chunk *chunk) {
-    if (!chunk->valid) return;
+void ordered_writer_submit(OrderedWriter *ow, Chunk *chunk) {
+    omp_set_lock(&ow->lock);
+    chunk->ready = 1;
+    omp_unset_lock(&ow->lock);
     
-    // Write chunk header (chunk_id, original_size, compressed_size)
-    fprintf(output_file, "[CHUNK %d: %d -> %d]\n", 
-            chunk->chunk_id, chunk->original_size, chunk->compressed_size);
-    
-    // Write compressed data
-    fwrite(chunk->compressed, 1, chunk->compressed_size, output_file);
-    fprintf(output_file, "\n");
-    
-    printf("[WRITE] Chunk %d: Written %d compressed bytes to output\n",
-           chunk->chunk_id, chunk->compressed_size);
+    while (omp_test_lock(&ow->writer_lock)) {
+        ordered_writer_flush(ow);
+        omp_unset_lock(&ow->writer_lock);
+        
+        // A chunk submitted while we were giving up the role would be missed
+        omp_set_lock(&ow->lock);
+        int more = ow->slots[ow->next_id % PIPELINE_SLOTS].ready;
+        omp_unset_lock(&ow->lock);
+        if (!more) break;
+    }
 }
 
 /**
- * Cleanup chunk memory
+ * Block until chunks [0, end) are written, helping to write them
+ * All of them must already be submitted or about to be.
  */
-void cleanup_chunk(Chunk *chunk) {
-    if (chunk->data) {
-        free(chunk->data);
-        chunk->data = NULL;
-    }
-    if (chunk->compressed) {
-        free(chunk->compressed);
-        chunk->compressed = NULL;
+void ordered_writer_wait(OrderedWriter *ow, uint64_t end) {
+    for (;;) {
+        omp_set_lock(&ow->lock);
+        int done = ow->next_id >= end;
+        omp_unset_lock(&ow->lock);
+        if (done) return;
+        
+        omp_set_lock(&ow->writer_lock);
+        ordered_writer_flush(ow);
+        omp_unset_lock(&ow->writer_lock);
     }
 }
 
 /**
  * Main compression pipeline using OpenMP tasks with dependencies
+ * 
+ * Streams the input in chunk_size pieces; memory stays bounded by the
+ * PIPELINE_SLOTS in-flight chunks whatever the file size. With a regular
+ * file the read stage disappears: each compress task takes its chunk
+ * straight from the mapping (or preads it), so nothing is serialized on
+ * the input. Returns 0 on success, -1 on error.
  */
-void compress_file_pipeline(const char *input_filename, const char *output_filename) {
-    FILE *input_file = fopen(input_filename, "rb");
-    if (!input_file) {
-        fprintf(stderr, "Error: Cannot open input file '%s'\n", input_filename);
-        return;
+int compress_file_pipeline(const char *input_filename, const char *output_filename,
+                           size_t chunk_size, int allow_mmap) {
+    InputSource input;
+    if (input_open(&input, input_filename, allow_mmap) != 0) {
+        return -1;
     }
     
     FILE *output_file = fopen(output_filename, "wb");
     if (!output_file) {
         fprintf(stderr, "Error: Cannot open output file '%s'\n", output_filename);
-        fclose(input_file);
-        return;
+        input_close(&input);
+        return -1;
+    }
+    
+    // Ring of in-flight chunks: chunk i uses slot i % PIPELINE_SLOTS
+    Chunk slots[PIPELINE_SLOTS];
+    memset(slots, 0, sizeof(slots));
+    
+    // Stored chunks are written from the input, so need no compressed buffer
+    size_t out_size = !active_codec ? auto_bound(chunk_size) :
+                      (active_codec->id == CODEC_STORED) ? 0 : active_codec->bound(chunk_size);
+    BufferPool pool;
+    if (buffer_pool_init(&pool, slots, PIPELINE_SLOTS,
+                         (input.mode == INPUT_MMAP) ? 0 : chunk_size, out_size) != 0) {
+        fprintf(stderr, "Error: Out of memory for %d chunk buffers\n", PIPELINE_SLOTS);
+        input_close(&input);
+        fclose(output_file);
+        return -1;
     }
     
     printf("\n=== Parallel File Compressor Pipeline ===\n");
-    printf("Input: %s\n", input_filename);
+    printf("Input: %s (%s)\n", input_filename, input_mode_name[input.mode]);
     printf("Output: %s\n", output_filename);
-    printf("Chunk size: %d bytes\n", CHUNK_SIZE);
+    printf("Chunk size: %zu bytes\n", chunk_size);
+    printf("Codec: %s\n", active_codec ? active_codec->name : "auto (rle, lz or stored per chunk)");
+    printf("In-flight chunks: %d\n", PIPELINE_SLOTS);
+    printf("Buffer pool: %d x (%zu + %zu) bytes, %d-byte aligned\n", PIPELINE_SLOTS,
+           pool.in_size, pool.out_size, CACHE_LINE);
     printf("OpenMP threads: %d\n\n", omp_get_max_threads());
     
     double total_start = omp_get_wtime();
     
-    // Allocate array of chunks
-    Chunk *chunks = (Chunk *)calloc(MAX_CHUNKS, sizeof(Chunk));
-    int total_chunks = 0;
-    int total_original_bytes = 0;
-    int total_compressed_bytes = 0;
+    crc32_init();
+    
+    ContainerWriter writer;
+    if (container_begin(&writer, output_file, (uint32_t)chunk_size) != 0) {
+        fprintf(stderr, "Error: Cannot write container header to '%s'\n", output_filename);
+        buffer_pool_destroy(&pool);
+        input_close(&input);
+        fclose(output_file);
+        return -1;
+    }
+    
+    OrderedWriter ow;
+    ordered_writer_init(&ow, &writer, slots);
+    int eof = 0;
+    int failed = 0;
     
     // OpenMP parallel region with task-based pipeline
     #pragma omp parallel
     {
         #pragma omp single
         {
-            int chunk_id = 0;
-            int done = 0;
+            uint64_t issued = 0;
             
-            while (!done && chunk_id < MAX_CHUNKS) {
-                Chunk *chunk = &chunks[chunk_id];
+            for (uint64_t chunk_id = 0; ; chunk_id++) {
+                Chunk *chunk = &slots[chunk_id % PIPELINE_SLOTS];
+                int stop, write_failed;
                 
-                // Task 1: Read chunk
-                #pragma omp task depend(out: chunk[0]) firstprivate(chunk_id)
-                {
-                    read_chunk(input_file, chunk, chunk_id);
-                    if (!chunk->valid) {
-                        printf("[PIPELINE] No more data to read\n");
-                    }
+                if (chunk_id >= PIPELINE_SLOTS) {
+                    // The slot's previous chunk must be compressed, then written
+                    #pragma omp taskwait depend(inout: chunk[0])
+                    ordered_writer_wait(&ow, chunk_id - PIPELINE_SLOTS + 1);
                 }
                 
-                // Task 2: Compress chunk (depends on read)
-                #pragma omp task depend(in: chunk[0]) depend(out: chunk[1]) firstprivate(chunk_id)
-                {
-                    if (chunk->valid) {
-                        compress_chunk(chunk);
+                #pragma omp atomic read
+                stop = eof;
+                #pragma omp atomic read
+                write_failed = ow.failed;
+                if (stop || write_failed) break;
+                
+                if (input.mode == INPUT_STREAM) {
+                    // Task 1: Read chunk (sequential input: reads stay in file order)
+                    #pragma omp task depend(inout: input) depend(out: chunk[0]) firstprivate(chunk_id)
+                    {
+                        int at_eof;
+                        #pragma omp atomic read
+                        at_eof = eof;
+                        
+                        chunk->failed = 0;
+                        if (at_eof) {
+                            chunk->valid = 0;
+                        } else {
+                            read_chunk(&input, chunk, chunk_id, chunk_size);
+                            if (!chunk->valid) {
+                                if (!chunk->failed && pipeline_verbose) {
+                                    printf("[PIPELINE] No more data to read\n");
+                                }
+                                #pragma omp atomic write
+                                eof = 1;
+                            }
+                        }
                     }
+                } else if (chunk_id * chunk_size >= input.size) {
+                    // Size known up front: end of file needs no read at all
+                    break;
                 }
                 
-                // Task 3: Write chunk (depends on compress)
-                #pragma omp task depend(in: chunk[1]) firstprivate(chunk_id)
+                // Task 2: Compress chunk (mapped/pread input is read here, in parallel),
+                // then hand it to the ordered writer (Task 3) without waiting
+                #pragma omp task depend(inout: chunk[0]) firstprivate(chunk_id)
                 {
+                    if (input.mode != INPUT_STREAM) {
+                        chunk->failed = 0;
+                        read_chunk(&input, chunk, chunk_id, chunk_size);
+                    }
                     if (chunk->valid) {
-                        write_chunk(output_file, chunk);
+                        compress_chunk(chunk);
                     }
+                    ordered_writer_submit(&ow, chunk);
                 }
-                
-                // Check if we've read all data
-                #pragma omp taskwait
-                
-                if (chunks[chunk_id].valid) {
-                    total_original_bytes += chunks[chunk_id].original_size;
-                    total_compressed_bytes += chunks[chunk_id].compressed_size;
-                    total_chunks++;
-                    chunk_id++;
-                } else {
-                    done = 1;
-                }
+                issued = chunk_id + 1;
             }
             
-            // Wait for all tasks to complete
+            // Wait for all tasks to complete, then drain the writer
             #pragma omp taskwait
+            ordered_writer_wait(&ow, issued);
         }
     }
     
-    double total_end = omp_get_wtime();
+    failed = ow.failed;
+    ordered_writer_destroy(&ow);
+    buffer_pool_destroy(&pool);
+    
+    // Chunks per codec, taken from the index before it is written out
+    uint64_t codec_chunks[NUM_CODECS] = {0};
+    for (uint64_t i = 0; i < writer.count; i++) {
+        codec_chunks[codec_by_id(writer.entries[i].codec) - codecs]++;
+    }
     
-    // Cleanup
-    for (int i = 0; i < total_chunks; i++) {
-        cleanup_chunk(&chunks[i]);
+    // The index is only written for a complete run; a prefix of the input
+    // must never look like a valid container
+    if (failed) {
+        container_abort(&writer);
+    } else if (container_finish(&writer) != 0) {
+        fprintf(stderr, "Error: Failed to write chunk index to '%s'\n", output_filename);
+        failed = 1;
     }
-    free(chunks);
     
-    fclose(input_file);
-    fclose(output_file);
+    double total_end = omp_get_wtime();
+    
+    input_close(&input);
+    if (fclose(output_file) != 0) {
+        fprintf(stderr, "Error: Failed to close '%s'\n", output_filename);
+        failed = 1;
+    }
+    if (failed && is_regular_file(output_filename) && remove(output_filename) != 0) {
+        fprintf(stderr, "Error: Cannot remove partial output '%s'\n", output_filename);
+    }
     
     // Print statistics
     printf("\n=== Compression Statistics ===\n");
-    printf("Total chunks processed: %d\n", total_chunks);
-    printf("Total original size: %d bytes\n", total_original_bytes);
-    printf("Total compressed size: %d bytes\n", total_compressed_bytes);
+    uint64_t total_original_bytes = ow.total_original_bytes;
+    uint64_t total_compressed_bytes = ow.total_compressed_bytes;
+    printf("Total chunks processed: %llu\n", (unsigned long long)ow.total_chunks);
+    printf("Total original size: %llu bytes\n", (unsigned long long)total_original_bytes);
+    printf("Total compressed size: %llu bytes\n", (unsigned long long)total_compressed_bytes);
+    printf("Write batches: %llu (%.1f chunks per vectored write)\n", (unsigned long long)ow.batches,
+           ow.batches ? (double)ow.total_chunks / ow.batches : 0.0);
+    printf("Container size: %llu bytes (headers and index included)\n",
+           (unsigned long long)writer.offset);
+    if (ow.total_chunks > 0) {
+        printf("Chunks per codec:");
+        for (int c = 0; c < NUM_CODECS; c++) {
+            if (codec_chunks[c]) printf(" %s %llu", codecs[c].name, (unsigned long long)codec_chunks[c]);
+        }
+        printf("\n");
+    }
     
     if (total_original_bytes > 0) {
         double compression_ratio = 100.0 * total_compressed_bytes / total_original_bytes;
-        double space_saved = 100.0 * (total_original_bytes - total_compressed_bytes) / total_original_bytes;
+        double space_saved = 100.0 - compression_ratio;
         printf("Compression ratio: %.2f%%\n", compression_ratio);
         printf("Space saved: %.2f%%\n", space_saved);
     }
     
-    printf("Total time: %.3f seconds\n", total_end - total_start);
+    double total_time = total_end - total_start;
+    printf("Total time: %.3f seconds", total_time);
+    if (total_time > 0) {
+        printf(" (%.1f MB/s)", total_original_bytes / total_time / 1e6);
+    }
+    printf("\n");
+    
+    if (failed) {
+        fprintf(stderr, "Error: Compression of '%s' did not complete; no output was kept\n", input_filename);
+        return -1;
+    }
     printf("\nOutput written to: %s\n", output_filename);
+    return 0;
+}
+
+// Chunks must tile the original file exactly, each within a valid chunk size
+static int index_covers_input(const ContainerIndex *idx) {
+    if (idx->chunk_size == 0 || idx->chunk_size > (uint32_t)MAX_CHUNK_KB * 1024) return 0;
+    
+    uint64_t expected_offset = 0;
+    for (uint64_t i = 0; i < idx->count; i++) {
+        if (idx->entries[i].raw_offset != expected_offset || idx->entries[i].raw_size > idx->chunk_size) {
+            return 0;
+        }
+        expected_offset += idx->entries[i].raw_size;
+    }
+    return expected_offset == idx->raw_total;
+}
+
+// The chunk header at h must repeat index entry i
+static int chunk_header_matches(const unsigned char *h, const ChunkIndexEntry *e, uint64_t i) {
+    return get_u32(h) == (uint32_t)i && get_u16(h + 4) == e->codec &&
+           get_u64(h + 8) == e->raw_offset && get_u32(h + 16) == e->raw_size &&
+           get_u32(h + 20) == e->compressed_size && get_u32(h + 24) == e->checksum;
+}
+
+#define DECODE_BATCH PIPELINE_SLOTS  // Chunks read and decoded together when restoring or verifying
+
+// Decodes a container's chunks DECODE_BATCH at a time into one window
+typedef struct {
+    FILE *file;
+    const ContainerIndex *idx;
+    unsigned char *body;    // Headers and payloads of the current batch
+    char *raw;              // Decoded batch; chunks sit at their raw offsets from raw_offset
+    size_t body_cap;
+    uint64_t next;          // First chunk of the next batch
+    uint64_t raw_offset;    // Original file offset of raw[0]
+    long long bad_chunk;    // Chunk that failed its checks, or -1
+    double read_time;
+    double decode_time;
+} BatchDecoder;
+
+/**
+ * Prepare to decode the chunks of an index that passed index_covers_input
+ * Memory is DECODE_BATCH chunks of raw data plus their largest encoding
+ */
+int batch_decoder_init(BatchDecoder *d, FILE *file, const ContainerIndex *idx) {
+    size_t max_payload = 0;
+    for (int c = 0; c < NUM_CODECS; c++) {
+        if (codecs[c].bound(idx->chunk_size) > max_payload) max_payload = codecs[c].bound(idx->chunk_size);
+    }
+    
+    memset(d, 0, sizeof(*d));
+    d->file = file;
+    d->idx = idx;
+    d->bad_chunk = -1;
+    d->body_cap = DECODE_BATCH * (CHUNK_HEADER_SIZE + max_payload);
+    d->body = (unsigned char *)malloc(d->body_cap);
+    d->raw = (char *)malloc((size_t)DECODE_BATCH * idx->chunk_size);
+    if (!d->body || !d->raw) {
+        free(d->body);
+        free(d->raw);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Read the next batch of chunks and decode them in parallel into d->raw
+ * 
+ * Returns the number of decoded bytes (0 once every chunk is done), or -1
+ * if the container cannot be read or a chunk is corrupt (d->bad_chunk >= 0)
+ */
+long long batch_decoder_next(BatchDecoder *d) {
+    const ContainerIndex *idx = d->idx;
+    if (d->next >= idx->count) return 0;
+    
+    uint64_t b = d->next;
+    int n = (idx->count - b < DECODE_BATCH) ? (int)(idx->count - b) : DECODE_BATCH;
+    const ChunkIndexEntry *first = &idx->entries[b];
+    const ChunkIndexEntry *last = &idx->entries[b + n - 1];
+    uint64_t body_end = last->file_offset + CHUNK_HEADER_SIZE + last->compressed_size;
+    size_t raw_span = (size_t)(last->raw_offset + last->raw_size - first->raw_offset);
+    
+    // container_read_index keeps chunks in file order, so this cannot wrap
+    if (body_end - first->file_offset > d->body_cap) {
+        d->bad_chunk = (long long)b;
+        return -1;
+    }
+    size_t body_span = (size_t)(body_end - first->file_offset);
+    
+    double read_start = omp_get_wtime();
+    if (file_seek(d->file, (long long)first->file_offset, SEEK_SET) != 0 ||
+        fread(d->body, 1, body_span, d->file) != body_span) {
+        return -1;
+    }
+    double read_end = omp_get_wtime();
+    
+    long long bad_chunk = -1;
+    #pragma omp parallel for schedule(dynamic, 1) reduction(max: bad_chunk)
+    for (int k = 0; k < n; k++) {
+        const ChunkIndexEntry *e = &idx->entries[b + k];
+        const unsigned char *h = d->body + (e->file_offset - first->file_offset);
+        char *dst = d->raw + (e->raw_offset - first->raw_offset);
+        
+        if (!chunk_header_matches(h, e, b + k)) {
+            bad_chunk = (long long)(b + k);
+            continue;
+        }
+        long long got = decode_payload(e->codec, (const char *)h + CHUNK_HEADER_SIZE, e->compressed_size,
+                                       dst, e->raw_size);
+        if (got != (long long)e->raw_size || crc32_update(0, dst, e->raw_size) != e->checksum) {
+            bad_chunk = (long long)(b + k);
+        }
+    }
+    d->read_time += read_end - read_start;
+    d->decode_time += omp_get_wtime() - read_end;
+    
+    if (bad_chunk >= 0) {
+        d->bad_chunk = bad_chunk;
+        return -1;
+    }
+    d->next = b + n;
+    d->raw_offset = first->raw_offset;
+    return (long long)raw_span;
+}
+
+void batch_decoder_destroy(BatchDecoder *d) {
+    free(d->body);
+    free(d->raw);
+    d->body = NULL;
+    d->raw = NULL;
+}
+
+// Open a container and load an index that covers the original file
+static FILE *open_container(const char *filename, ContainerIndex *idx) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot open container '%s'\n", filename);
+        return NULL;
+    }
+    
+    crc32_init();
+    
+    if (container_read_index(file, idx) != 0) {
+        fclose(file);
+        return NULL;
+    }
+    if (!index_covers_input(idx)) {
+        fprintf(stderr, "Error: Chunk index of '%s' does not cover the original file\n", filename);
+        container_free_index(idx);
+        fclose(file);
+        return NULL;
+    }
+    return file;
+}
+
+/**
+ * Restore the original file from a container
+ * 
+ * Chunks are read and decoded DECODE_BATCH at a time, in parallel, and each
+ * batch is written at its raw offset before the next is read, so memory is
+ * bounded by the batch window rather than by the file size.
+ */
+int decompress_file(const char *input_filename, const char *output_filename) {
+    printf("\n=== Parallel File Decompressor ===\n");
+    printf("Input: %s\n", input_filename);
+    printf("Output: %s\n", output_filename);
+    printf("OpenMP threads: %d\n\n", omp_get_max_threads());
+    
+    double total_start = omp_get_wtime();
+    
+    ContainerIndex idx;
+    FILE *container = open_container(input_filename, &idx);
+    if (!container) return -1;
+    
+    BatchDecoder dec;
+    if (batch_decoder_init(&dec, container, &idx) != 0) {
+        fprintf(stderr, "Error: Out of memory decompressing '%s'\n", input_filename);
+        container_free_index(&idx);
+        fclose(container);
+        return -1;
+    }
+    
+    FILE *output_file = fopen(output_filename, "wb");
+    if (!output_file) {
+        fprintf(stderr, "Error: Cannot open output file '%s'\n", output_filename);
+        batch_decoder_destroy(&dec);
+        container_free_index(&idx);
+        fclose(container);
+        return -1;
+    }
+    
+    double write_time = 0.0;
+    long long got;
+    int status = 0;
+    while ((got = batch_decoder_next(&dec)) > 0) {
+        double write_start = omp_get_wtime();
+        if (fwrite(dec.raw, 1, (size_t)got, output_file) != (size_t)got) {
+            fprintf(stderr, "Error: Failed to write '%s'\n", output_filename);
+            status = -1;
+            break;
+        }
+        write_time += omp_get_wtime() - write_start;
+    }
+    if (got < 0) {
+        if (dec.bad_chunk >= 0) {
+            fprintf(stderr, "Error: Chunk %lld of '%s' is corrupt\n", dec.bad_chunk, input_filename);
+        } else {
+            fprintf(stderr, "Error: Cannot read chunks of '%s'\n", input_filename);
+        }
+        status = -1;
+    }
+    if (fclose(output_file) != 0) status = -1;
+    fclose(container);
+    batch_decoder_destroy(&dec);
+    double total_end = omp_get_wtime();
+    
+    // A partly restored file must not be mistaken for the original
+    if (status != 0 && is_regular_file(output_filename) && remove(output_filename) != 0) {
+        fprintf(stderr, "Error: Cannot remove partial output '%s'\n", output_filename);
+    }
+    
+    if (status == 0) {
+        printf("Chunks decoded: %llu (%llu bytes, %d per batch)\n", (unsigned long long)idx.count,
+               (unsigned long long)idx.raw_total, DECODE_BATCH);
+    }
+    printf("Read time: %.3f seconds\n", dec.read_time);
+    printf("Decode time: %.3f seconds", dec.decode_time);
+    if (status == 0 && dec.decode_time > 0) {
+        printf(" (%.2f GB/s)", idx.raw_total / dec.decode_time / 1e9);
+    }
+    printf("\n");
+    printf("Write time: %.3f seconds\n", write_time);
+    printf("Total time: %.3f seconds\n", total_end - total_start);
+    container_free_index(&idx);
+    
+    if (status == 0) {
+        printf("\nOutput written to: %s\n", output_filename);
+    }
+    return status;
+}
+
+/**
+ * Check that a container decodes back to the original file
+ * 
+ * Decodes the container DECODE_BATCH chunks at a time and compares each
+ * batch with the matching range of the original, so memory is a few
+ * chunk-sized buffers whatever the file size.
+ */
+int verify_round_trip(const char *original_filename, const char *container_filename) {
+    printf("\n=== Round-Trip Check ===\n");
+    
+    ContainerIndex idx;
+    FILE *container = open_container(container_filename, &idx);
+    if (!container) return -1;
+    
+    BatchDecoder dec;
+    FILE *original = fopen(original_filename, "rb");
+    char *expected = (char *)malloc((size_t)DECODE_BATCH * idx.chunk_size);
+    int match = 1;
+    
+    if (batch_decoder_init(&dec, container, &idx) != 0) {
+        fprintf(stderr, "Error: Out of memory verifying '%s'\n", container_filename);
+        free(expected);
+        if (original) fclose(original);
+        container_free_index(&idx);
+        fclose(container);
+        return -1;
+    }
+    if (!original) {
+        fprintf(stderr, "Error: Cannot open '%s'\n", original_filename);
+        match = 0;
+    } else if (!expected) {
+        fprintf(stderr, "Error: Out of memory verifying '%s'\n", container_filename);
+        match = 0;
+    }
+    
+    long long got = 0;
+    while (match && (got = batch_decoder_next(&dec)) > 0) {
+        // A short read means the original is shorter than the container says
+        if (fread(expected, 1, (size_t)got, original) != (size_t)got || memcmp(dec.raw, expected, (size_t)got) != 0) {
+            match = 0;
+        }
+    }
+    if (got < 0) {
+        if (dec.bad_chunk >= 0) {
+            fprintf(stderr, "Error: Chunk %lld of '%s' is corrupt\n", dec.bad_chunk, container_filename);
+        } else {
+            fprintf(stderr, "Error: Cannot read chunks of '%s'\n", container_filename);
+        }
+        match = 0;
+    }
+    
+    // Nothing may follow the last chunk in the original
+    if (match && fgetc(original) != EOF) match = 0;
+    
+    if (original) fclose(original);
+    fclose(container);
+    batch_decoder_destroy(&dec);
+    free(expected);
+    
+    if (match) {
+        printf("Chunks verified: %llu (%d per batch)\n", (unsigned long long)idx.count, DECODE_BATCH);
+    }
+    container_free_index(&idx);
+    printf("Round trip: %s\n", match ? "OK (output matches input)" : "FAILED");
+    return match ? 0 : -1;
+}
+
+/**
+ * Print the chunk index of a container
+ */
+int list_container(const char *filename) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        fprintf(stderr, "Error: Cannot open container '%s'\n", filename);
+        return -1;
+    }
+    
+    crc32_init();
+    
+    ContainerIndex idx;
+    if (container_read_index(file, &idx) != 0) {
+        fclose(file);
+        return -1;
+    }
+    fclose(file);
+    
+    printf("\n=== Container Index: %s ===\n", filename);
+    printf("Chunk size: %u bytes\n", idx.chunk_size);
+    printf("Chunks: %llu\n", (unsigned long long)idx.count);
+    printf("Original size: %llu bytes\n\n", (unsigned long long)idx.raw_total);
+    printf("%8s %12s %12s %10s %10s %10s   %s\n", "chunk", "offset", "raw_offset", "raw", "packed", "crc32", "codec");
+    
+    for (uint64_t i = 0; i < idx.count; i++) {
+        const ChunkIndexEntry *e = &idx.entries[i];
+        const Codec *codec = codec_by_id(e->codec);
+        printf("%8llu %12llu %12llu %10u %10u   %08x   %s\n", (unsigned long long)i,
+               (unsigned long long)e->file_offset, (unsigned long long)e->raw_offset,
+               e->raw_size, e->compressed_size, e->checksum, codec ? codec->name : "?");
+    }
+    
+    container_free_index(&idx);
+    return 0;
+}
+
+#define BENCH_CHUNK (256 * 1024)  // Codec benchmark works chunk by chunk, like the pipeline
+#define BENCH_REPS 3
+
+static const char *bench_input_names[] = {"long-runs", "short-runs", "logs", "text", "random", "zeros"};
+#define BENCH_INPUTS 6
+
+// splitmix64 step for benchmark data
+static uint64_t bench_random(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// Benchmark inputs, from very run-heavy to incompressible
+static void fill_bench_input(unsigned char *buf, size_t n, int kind) {
+    const char chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    const char *levels[] = {"INFO", "WARN", "DEBUG", "ERROR"};
+    uint64_t state = 42 + kind;
+    uint64_t line = 0;
+    size_t i = 0;
+    
+    while (i < n) {
+        uint64_t r = bench_random(&state);
+        size_t len;
+        unsigned char c;
+        
+        if (kind == 2) {
+            // Application log lines: repeated structure, varying fields
+            char text[160];
+            len = (size_t)snprintf(text, sizeof(text),
+                                   "2026-10-15 12:%02d:%02d.%03d %s worker-%d processed request id=%llu in %d ms\n",
+                                   (int)(line / 60000 % 60), (int)(line / 1000 % 60), (int)(line % 1000),
+                                   levels[r % 4], (int)(r >> 8) % 16, (unsigned long long)(100000 + line),
+                                   (int)(r >> 16) % 300);
+            if (len > n - i) len = n - i;
+            memcpy(buf + i, text, len);
+            i += len;
+            line++;
+            continue;
+        }
+        
+        switch (kind) {
+            case 0: len = 50 + r % 51; c = chars[(r >> 8) % 36]; break;  // create_test_file-style
+            case 1: len = 1 + r % 8; c = chars[(r >> 8) % 4]; break;     // short runs, small alphabet
+            case 3: len = 1; c = chars[r % 26]; break;                   // letters, few repeats
+            case 4: len = 1; c = (unsigned char)r; break;                // incompressible
+            default: len = n; c = 0; break;
+        }
+        if (len > n - i) len = n - i;
+        memset(buf + i, c, len);
+        i += len;
+    }
+}
+
+/**
+ * Benchmark every codec on one core
+ * 
+ * RLE is run once per run scanner the CPU supports, next to the original
+ * text RLE, LZ77, Huffman, LZ77+Huffman, stored and the per-chunk auto
+ * choice (sampling time included). Every encoding is decoded and checked.
+ * Reports GB/s of input processed (best of BENCH_REPS).
+ */
+int run_codec_benchmark(long long size_mb) {
+    size_t n = (size_t)size_mb * 1024 * 1024;
+    size_t chunks = (n + BENCH_CHUNK - 1) / BENCH_CHUNK;
+    size_t max_bound = 0;
+    
+    for (int c = 0; c < NUM_CODECS; c++) {
+        if (codecs[c].bound(BENCH_CHUNK) > max_bound) max_bound = codecs[c].bound(BENCH_CHUNK);
+    }
+    
+    unsigned char *input = (unsigned char *)malloc(n);
+    unsigned char *encoded = (unsigned char *)malloc(chunks * max_bound);
+    unsigned char *decoded = (unsigned char *)malloc(n);
+    size_t *chunk_sizes = (size_t *)malloc((chunks + 1) * sizeof(size_t));
+    uint16_t *chunk_codecs = (uint16_t *)malloc((chunks + 1) * sizeof(uint16_t));
+    
+    if (!input || !encoded || !decoded || !chunk_sizes || !chunk_codecs) {
+        fprintf(stderr, "Error: Out of memory for a %lld MB codec benchmark\n", size_mb);
+        free(input);
+        free(encoded);
+        free(decoded);
+        free(chunk_sizes);
+        free(chunk_codecs);
+        return -1;
+    }
+    
+    const RleScanner *best_scanner = rle_scanner;
+    int scanners = (int)(sizeof(rle_scanners) / sizeof(rle_scanners[0]));
+    
+    printf("\n=== Codec Benchmark (%lld MB per input, %d KB chunks, 1 thread) ===\n",
+           size_mb, BENCH_CHUNK / 1024);
+    printf("Fastest RLE scanner on this CPU: %s\n\n", select_rle_scanner());
+    printf("%-11s %-14s %9s %12s %12s %8s\n", "Input", "Codec", "Ratio", "Enc GB/s", "Dec GB/s", "Check");
+    
+    int all_ok = 1;
+    
+    for (int kind = 0; kind < BENCH_INPUTS; kind++) {
+        fill_bench_input(input, n, kind);
+        
+        // One row per codec, one RLE row per scanner, then the per-chunk choice
+        for (int c = 0; c <= NUM_CODECS; c++) {
+            const Codec *codec = (c < NUM_CODECS) ? &codecs[c] : NULL;
+            int rows = (codec && codec->id == CODEC_RLE) ? scanners : 1;
+            
+            for (int v = 0; v < rows; v++) {
+                char label[32];
+                rle_scanner = best_scanner;
+                if (!codec) {
+                    snprintf(label, sizeof(label), "auto");
+                } else if (codec->id == CODEC_RLE) {
+#ifdef HAVE_SIMD_SCAN
+                    if (strcmp(rle_scanners[v].name, "avx2") == 0 && !__builtin_cpu_supports("avx2")) continue;
+#endif
+                    rle_scanner = &rle_scanners[v];
+                    snprintf(label, sizeof(label), "rle/%s", rle_scanners[v].name);
+                } else {
+                    snprintf(label, sizeof(label), "%s", codec->name);
+                }
+                
+                double enc_best = 1e30, dec_best = 1e30;
+                size_t total = 0;
+                int ok = 1;
+                
+                for (int rep = 0; rep < BENCH_REPS; rep++) {
+                    double t0 = omp_get_wtime();
+                    size_t pos = 0;
+                    for (size_t k = 0; k < chunks; k++) {
+                        size_t off = k * BENCH_CHUNK;
+                        size_t len = (n - off < BENCH_CHUNK) ? n - off : BENCH_CHUNK;
+                        const char *src = (const char *)input + off;
+                        const Codec *used = codec ? codec : choose_codec(src, len);
+                        chunk_sizes[k] = used->compress(src, len, (char *)encoded + pos);
+                        if (!codec && chunk_sizes[k] >= len) {
+                            used = codec_by_id(CODEC_STORED);
+                            chunk_sizes[k] = used->compress(src, len, (char *)encoded + pos);
+                        }
+                        chunk_codecs[k] = used->id;
+                        pos += chunk_sizes[k];
+                    }
+                    double t1 = omp_get_wtime();
+                    total = pos;
+                    
+                    pos = 0;
+                    for (size_t k = 0; k < chunks; k++) {
+                        size_t off = k * BENCH_CHUNK;
+                        size_t len = (n - off < BENCH_CHUNK) ? n - off : BENCH_CHUNK;
+                        long long got = decode_payload(chunk_codecs[k], (const char *)encoded + pos,
+                                                       chunk_sizes[k], (char *)decoded + off, len);
+                        if (got != (long long)len) ok = 0;
+                        pos += chunk_sizes[k];
+                    }
+                    double t2 = omp_get_wtime();
+                    
+                    if (t1 - t0 < enc_best) enc_best = t1 - t0;
+                    if (t2 - t1 < dec_best) dec_best = t2 - t1;
+                }
+                ok = ok && memcmp(input, decoded, n) == 0;
+                all_ok = all_ok && ok;
+                
+                printf("%-11s %-14s %8.1f%% %12.2f %12.2f %8s\n", bench_input_names[kind], label,
+                       100.0 * total / n, n / enc_best / 1e9, n / dec_best / 1e9, ok ? "OK" : "FAILED");
+            }
+        }
+        printf("\n");
+    }
+    
+    rle_scanner = best_scanner;
+    free(input);
+    free(encoded);
+    free(decoded);
+    free(chunk_sizes);
+    free(chunk_codecs);
+    return all_ok ? 0 : -1;
 }
 
 /**
  * Create a sample test file with compressible data
  * Modified to generate RLE-friendly data with long runs of identical characters
  */
-void create_test_file(const char *filename, int size_kb) {
+int create_test_file(const char *filename, long long size_kb) {
     FILE *file = fopen(filename, "wb");
     if (!file) {
         fprintf(stderr, "Error: Cannot create test file '%s'\n", filename);
-        return;
+        return -1;
     }
     
-    printf("Creating test file '%s' (%d KB)...\n", filename, size_kb);
+    printf("Creating test file '%s' (%lld KB)...\n", filename, size_kb);
     
-    int bytes_to_write = size_kb * 1024;
-    int bytes_written = 0;
+    uint64_t bytes_to_write = (uint64_t)size_kb * 1024;
+    uint64_t bytes_written = 0;
     
     // Create highly compressible data with LONG runs of identical characters
     // This demonstrates RLE compression effectively
     const char chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
     int num_chars = strlen(chars);
-    int char_index = 0;
+    uint64_t char_index = 0;
     
     while (bytes_written < bytes_to_write) {
         char current_char = chars[char_index % num_chars];
         
         // Write long runs of 50-100 identical characters for good compression
-        int run_length = 50 + (char_index * 7) % 51;  // 50-100 chars
+        int run_length = 50 + (int)((char_index * 7) % 51);  // 50-100 chars
         
         for (int i = 0; i < run_length && bytes_written < bytes_to_write; i++) {
             fputc(current_char, file);
@@ -305,37 +2581,108 @@ void create_test_file(const char *filename, int size_kb) {
         char_index++;
     }
     
-    fclose(file);
+    if (fclose(file) != 0) {
+        fprintf(stderr, "Error: Failed to write test file '%s'\n", filename);
+        return -1;
+    }
     printf("Test file created successfully.\n\n");
+    return 0;
 }
 
 int main(int argc, char *argv[]) {
     const char *input_file;
-    const char *output_file = "compressed_output.txt";
+    const char *output_file = "compressed_output.pfc";
+    size_t chunk_size = (size_t)DEFAULT_CHUNK_KB * 1024;
+    int allow_mmap = 1;
+    
+    // Pull out the option flags; the remaining arguments select the mode
+    char **args = (char **)malloc(argc * sizeof(char *));
+    int nargs = 0;
+    args[nargs++] = argv[0];
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--chunk-size") == 0 && i + 1 < argc) {
+            long long kb = atoll(argv[++i]);
+            if (kb < MIN_CHUNK_KB || kb > MAX_CHUNK_KB) {
+                fprintf(stderr, "Error: --chunk-size must be between %d and %d KB\n",
+                        MIN_CHUNK_KB, MAX_CHUNK_KB);
+                free(args);
+                return 1;
+            }
+            chunk_size = (size_t)kb * 1024;
+        } else if (strcmp(argv[i], "--quiet") == 0) {
+            pipeline_verbose = 0;
+        } else if (strcmp(argv[i], "--no-mmap") == 0) {
+            allow_mmap = 0;
+        } else if (strcmp(argv[i], "--codec") == 0 && i + 1 < argc) {
+            i++;
+            active_codec = (strcmp(argv[i], "auto") == 0) ? NULL : codec_by_name(argv[i]);
+            if (!active_codec && strcmp(argv[i], "auto") != 0) {
+                fprintf(stderr, "Error: Unknown codec '%s' (auto, rle, lz, huffman, lzh, rle-text, stored)\n", argv[i]);
+                free(args);
+                return 1;
+            }
+        } else {
+            args[nargs++] = argv[i];
+        }
+    }
+    argc = nargs;
+    argv = args;
+    select_rle_scanner();
     
+    int status;
     if (argc < 2) {
-        printf("Usage: %s <input_file> [output_file]\n", argv[0]);
-        printf("   or: %s --test [size_in_kb]\n\n", argv[0]);
+        printf("Usage: %s <input_file|-> [output_file] [--codec name] [--chunk-size KB] [--no-mmap] [--quiet]\n", argv[0]);
+        printf("   or: %s --test [size_in_kb]\n", argv[0]);
+        printf("   or: %s --decompress <container> [output_file]\n", argv[0]);
+        printf("   or: %s --list <container>\n", argv[0]);
+        printf("   or: %s --bench-codec [size_in_mb]\n\n", argv[0]);
         
         // Default: create and compress a test file
         printf("No input file specified. Creating test file...\n\n");
         input_file = "test_input.txt";
-        create_test_file(input_file, 10);  // 10 KB test file
+        status = create_test_file(input_file, 10);  // 10 KB test file
+    } else if (strcmp(argv[1], "--decompress") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "Error: --decompress needs a container file\n");
+            free(args);
+            return 1;
+        }
+        const char *restored = (argc > 3) ? argv[3] : "decompressed_output.txt";
+        status = decompress_file(argv[2], restored);
+        free(args);
+        return status == 0 ? 0 : 1;
+    } else if (strcmp(argv[1], "--bench-codec") == 0) {
+        long long size_mb = (argc > 2) ? atoll(argv[2]) : 32;
+        if (size_mb < 1) size_mb = 32;
+        status = run_codec_benchmark(size_mb);
+        free(args);
+        return status == 0 ? 0 : 1;
+    } else if (strcmp(argv[1], "--list") == 0) {
+        if (argc < 3) {
+            fprintf(stderr, "Error: --list needs a container file\n");
+            free(args);
+            return 1;
+        }
+        status = list_container(argv[2]);
+        free(args);
+        return status == 0 ? 0 : 1;
     } else if (strcmp(argv[1], "--test") == 0) {
         input_file = "test_input.txt";
-        int size_kb = (argc > 2) ? atoi(argv[2]) : 10;
+        long long size_kb = (argc > 2) ? atoll(argv[2]) : 10;
         if (size_kb < 1) size_kb = 10;
-        create_test_file(input_file, size_kb);
+        status = create_test_file(input_file, size_kb);
     } else {
         input_file = argv[1];
         if (argc > 2) {
             output_file = argv[2];
         }
+        status = 0;
     }
     
-    // Run the compression pipeline
-    compress_file_pipeline(input_file, output_file);
+    // Run the compression pipeline, then check that it decodes back
+    if (status == 0) status = compress_file_pipeline(input_file, output_file, chunk_size, allow_mmap);
+    if (status == 0 && is_regular_file(input_file)) status = verify_round_trip(input_file, output_file);
     
-    return 0;
+    free(args);
+    return status == 0 ? 0 : 1;
 }
-